@@ -0,0 +1,199 @@
+#include "audio.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#define SYNC_TOLERANCE  10000000  // ns: below, nothing is corrected
+#define SYNC_RESET      60000000  // ns: beyond, skip / insert silence at once (instead of single samples per block)
+
+void AudioRing::reset(int channels, int rate, size_t min_frames)
+{
+  this->channels = channels;
+  this->rate = rate;
+  capacity = 1;
+  while (capacity < min_frames) {
+    capacity *= 2;
+  }
+  buf.assign((size_t)channels * capacity, 0.0f);
+  wpos = rpos = 0;
+  wmark = rmark = 0;
+}
+
+bool AudioRing::push(const float *data, size_t channel_stride, size_t frames, int64_t timestamp)
+{
+  const uint64_t w = wpos.load(std::memory_order_relaxed),
+                 r = rpos.load(std::memory_order_acquire),
+                 m = wmark.load(std::memory_order_relaxed);
+  if (capacity - (w - r) < frames ||
+      m - rmark.load(std::memory_order_acquire) >= num_marks - 1) {
+    return false;
+  }
+
+  const size_t pos = w & (capacity - 1),
+               first = std::min(frames, capacity - pos);
+  for (int c = 0; c < channels; c++) {
+    const float *src = data + c * channel_stride;
+    float *dst = &buf[c * capacity];
+    memcpy(dst + pos, src, first * sizeof(float));
+    memcpy(dst, src + first, (frames - first) * sizeof(float));
+  }
+
+  marks[m % num_marks] = {w, timestamp};
+  wmark.store(m + 1, std::memory_order_release);
+  wpos.store(w + frames, std::memory_order_release);
+  return true;
+}
+
+int64_t AudioRing::timestamp()
+{
+  const uint64_t r = rpos.load(std::memory_order_relaxed),
+                 wm = wmark.load(std::memory_order_acquire);
+  uint64_t m = rmark.load(std::memory_order_relaxed);
+  if (m == wm) {
+    return 0;
+  }
+  while (m + 1 < wm && marks[(m + 1) % num_marks].pos <= r) {
+    m++;
+  }
+  rmark.store(m, std::memory_order_release);
+
+  const mark_t &mark = marks[m % num_marks];
+  if (!mark.timestamp) {
+    return 0;
+  }
+  return mark.timestamp + (int64_t)((r - mark.pos) * 10000000 / rate);
+}
+
+void AudioRing::read(float *interleaved, size_t frames)
+{
+  const uint64_t r = rpos.load(std::memory_order_relaxed);
+  for (int c = 0; c < channels; c++) {
+    const float *src = &buf[c * capacity];
+    for (size_t i = 0; i < frames; i++) {
+      interleaved[i * channels + c] = src[(r + i) & (capacity - 1)];
+    }
+  }
+  rpos.store(r + frames, std::memory_order_release);
+}
+
+void AudioRing::skip(size_t frames)
+{
+  rpos.store(rpos.load(std::memory_order_relaxed) + frames, std::memory_order_release);
+}
+
+
+AudioOutput::AudioOutput(std::unique_ptr<AudioSink> sink)
+  : sink(std::move(sink))
+{
+}
+
+AudioOutput::~AudioOutput()
+{
+  stop();
+}
+
+void AudioOutput::push(const float *data, int channel_stride_in_bytes, int channels, int samples, int rate, int64_t timestamp)
+{
+  if (channels != this->channels || rate != this->rate) {
+    start(channels, rate);
+  }
+  if (failed) {
+    return;
+  }
+  if (!ring.push(data, channel_stride_in_bytes / sizeof(float), samples, timestamp)) {
+    num_dropped += samples;
+  }
+}
+
+void AudioOutput::video_shown(int64_t timestamp, clock::time_point at)
+{
+  if (!timestamp) {
+    return;
+  }
+  // (smoothed: arrival jitter)
+  const int64_t offset = std::chrono::duration_cast<std::chrono::nanoseconds>(at.time_since_epoch()).count() - timestamp * 100,
+                cur = video_offset.load(std::memory_order_relaxed);
+  if (!cur || llabs(offset - cur) > SYNC_RESET) {
+    video_offset.store(offset, std::memory_order_relaxed);
+  } else {
+    video_offset.store(cur + (offset - cur) / 16, std::memory_order_relaxed);
+  }
+}
+
+// NOTE: only on format change, waits for the worker (i.e. for up to one sink write)
+void AudioOutput::start(int channels, int rate)
+{
+  stop();
+  this->channels = channels;
+  this->rate = rate;
+
+  failed = (channels <= 0 || rate <= 0 || !sink->open(channels, rate));
+  if (failed) {
+    return;
+  }
+  ring.reset(channels, rate, rate);  // ~1 s
+  thread = std::thread(&AudioOutput::worker, this);
+}
+
+void AudioOutput::stop()
+{
+  if (thread.joinable()) {
+    stopping = true;
+    thread.join();
+    stopping = false;
+  }
+}
+
+void AudioOutput::worker()
+{
+  const size_t block = std::max(rate / 100, 1),  // 10 ms
+               max_adjust = std::max<size_t>(block / 50, 1);  // per block: 2% speed change at most
+  std::vector<float> buf((block + max_adjust) * channels);
+
+  while (!stopping.load(std::memory_order_relaxed)) {
+    size_t avail = ring.available();
+    if (avail < block) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));  // TODO? futex
+      continue;
+    }
+
+    size_t repeat = 0;
+    const int64_t timestamp = ring.timestamp(),
+                  voffset = video_offset.load(std::memory_order_relaxed);
+    if (timestamp && voffset) {
+      const int64_t due = timestamp * 100 + voffset,
+                    out = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch() + sink->delay()).count(),
+                    late = out - due;
+      if (late > SYNC_RESET) {
+        const size_t num = std::min(avail, (size_t)(late * rate / 1000000000));
+        ring.skip(num);
+        num_dropped += num;
+        continue;
+      } else if (late < -SYNC_RESET) {
+        const size_t num = std::min(block, (size_t)(-late * rate / 1000000000));
+        std::fill(buf.begin(), buf.begin() + num * channels, 0.0f);
+        sink->write(buf.data(), num);
+        num_inserted += num;
+        continue;
+      } else if (llabs(late) > SYNC_TOLERANCE) { // drift: a few samples per block, more the further off
+        const size_t adjust = std::min(1 + (size_t)((llabs(late) - SYNC_TOLERANCE) * rate / 1000000000 / 16), max_adjust);
+        if (late > 0) {
+          ring.skip(adjust);
+          num_dropped += adjust;
+          avail -= adjust;
+        } else {
+          repeat = adjust;
+        }
+      }
+    }
+
+    size_t num = std::min(block, avail);
+    ring.read(buf.data(), num);
+    for (; repeat > 0; repeat--) { // (repeat the last sample)
+      memcpy(&buf[num * channels], &buf[(num - 1) * channels], channels * sizeof(float));
+      num++;
+      num_inserted++;
+    }
+    sink->write(buf.data(), num);  // (false: lost, nothing to do about it)
+  }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "audiosink.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Lock-free single producer / single consumer ring of float planar samples, with the (NDI) timestamps of the pushed chunks.
+class AudioRing {
+public:
+  // NOTE: not while push/read are running
+  void reset(int channels, int rate, size_t min_frames);
+
+  // producer; returns false when there is not enough space (nothing is stored then)
+  bool push(const float *data, size_t channel_stride, size_t frames, int64_t timestamp);  // (stride in floats)
+
+  // consumer
+  size_t available() const {
+    return wpos.load(std::memory_order_acquire) - rpos.load(std::memory_order_relaxed);
+  }
+  int64_t timestamp();   // of the next frame to read (100 ns), 0: unknown
+  void read(float *interleaved, size_t frames);
+  void skip(size_t frames);
+
+private:
+  int channels = 0, rate = 0;
+  size_t capacity = 0;  // (power of 2)
+  std::vector<float> buf;  // channel c at [c * capacity]
+
+  static constexpr size_t num_marks = 256;
+  struct mark_t {
+    uint64_t pos;
+    int64_t timestamp;
+  } marks[num_marks];
+  std::atomic<uint64_t> wmark{0}, rmark{0};  // rmark: current mark of the consumer
+
+  std::atomic<uint64_t> wpos{0}, rpos{0};
+};
+
+// Plays received audio through a sink, in its own thread (a stalled device never blocks the caller),
+// lip-synced to the video presentation clock: the sample with timestamp T is timed to leave the device
+// together with the video frame with timestamp T. Drift is corrected by dropping / repeating single samples,
+// large offsets by skipping samples / inserting silence.
+class AudioOutput {
+public:
+  using clock = std::chrono::steady_clock;
+
+  explicit AudioOutput(std::unique_ptr<AudioSink> sink);
+  ~AudioOutput();
+
+  AudioOutput(const AudioOutput &) = delete;
+  AudioOutput &operator=(const AudioOutput &) = delete;
+
+  // never waits for the device (ring full: dropped); format change reopens the sink
+  void push(const float *data, int channel_stride_in_bytes, int channels, int samples, int rate, int64_t timestamp);
+
+  // video frame with timestamp (100 ns) was shown at `at`; 0: untimed
+  void video_shown(int64_t timestamp, clock::time_point at = clock::now());
+
+  uint64_t dropped() const { return num_dropped; }     // samples (ring overflow, sync)
+  uint64_t inserted() const { return num_inserted; }   // samples (sync)
+
+private:
+  void start(int channels, int rate);
+  void stop();
+  void worker();
+
+  std::unique_ptr<AudioSink> sink;
+  bool failed = false;  // sink does not accept the format
+  int channels = 0, rate = 0;
+
+  AudioRing ring;
+  std::atomic<int64_t> video_offset{0};  // local clock (ns) - timestamp; 0: unknown
+
+  std::atomic<bool> stopping{false};
+  std::thread thread;
+
+  std::atomic<uint64_t> num_dropped{0}, num_inserted{0};
+};
@@ -0,0 +1,194 @@
+#include "audiosink.h"
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+#define WAV_BUFFER  std::chrono::milliseconds(100)
+
+std::unique_ptr<AudioSink> create_audio_sink(const char *spec)
+{
+  if (strcmp(spec, "alsa") == 0 || strncmp(spec, "alsa:", 5) == 0) {
+#ifdef HAVE_ALSA
+    return std::unique_ptr<AudioSink>(new AlsaSink((spec[4]) ? spec + 5 : "default"));
+#else
+    throw std::runtime_error("Not compiled with ALSA support");
+#endif
+  }
+  return std::unique_ptr<AudioSink>(new WavSink(spec));
+}
+
+// NOTE: little endian only
+struct wav_header_t {
+  char riff[4];
+  uint32_t riff_size;
+  char wave[4];
+  char fmt[4];
+  uint32_t fmt_size;
+  uint16_t format, channels;
+  uint32_t rate, byte_rate;
+  uint16_t block_align, bits;
+  char data[4];
+  uint32_t data_size;
+} __attribute__((packed));
+
+static wav_header_t wav_header(int channels, int rate, uint64_t frames)
+{
+  const uint32_t data_size = (uint32_t)std::min<uint64_t>(frames * channels * sizeof(float), UINT32_MAX - sizeof(wav_header_t));
+  return {
+    {'R', 'I', 'F', 'F'}, (uint32_t)(sizeof(wav_header_t) - 8 + data_size), {'W', 'A', 'V', 'E'},
+    {'f', 'm', 't', ' '}, 16,
+    3, (uint16_t)channels,  // WAVE_FORMAT_IEEE_FLOAT
+    (uint32_t)rate, (uint32_t)(rate * channels * sizeof(float)),
+    (uint16_t)(channels * sizeof(float)), 32,
+    {'d', 'a', 't', 'a'}, data_size
+  };
+}
+
+WavSink::WavSink(const char *filename)
+  : filename(filename)
+{
+  f = fopen(filename, "wb");
+  if (!f) {
+    throw std::system_error(errno, std::generic_category(), std::string("Could not open ") + filename);
+  }
+}
+
+WavSink::~WavSink()
+{
+  if (channels) {
+    const wav_header_t hdr = wav_header(channels, rate, frames);
+    fseek(f, 0, SEEK_SET);
+    fwrite(&hdr, sizeof(hdr), 1, f);
+  }
+  fclose(f);
+}
+
+bool WavSink::open(int channels, int rate)
+{
+  if (this->channels) {
+    if (channels != this->channels || rate != this->rate) {
+      fprintf(stderr, "Audio format changed (%d channels, %d Hz), cannot continue %s.\n", channels, rate, filename.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  this->channels = channels;
+  this->rate = rate;
+  const wav_header_t hdr = wav_header(channels, rate, 0);
+  fwrite(&hdr, sizeof(hdr), 1, f);
+  return true;
+}
+
+bool WavSink::write(const float *data, size_t num)
+{
+  using clock = std::chrono::steady_clock;
+  const clock::time_point now = clock::now();
+  const std::chrono::nanoseconds written{frames * 1000000000 / rate};
+  if (!frames || start + written < now) { // (underrun: a device would have played silence meanwhile)
+    start = now - written;
+  }
+
+  if (fwrite(data, channels * sizeof(float), num, f) != num) {
+    return false;
+  }
+  frames += num;
+
+  const std::chrono::nanoseconds ahead = delay();
+  if (ahead > WAV_BUFFER) {
+    std::this_thread::sleep_for(ahead - WAV_BUFFER);
+  }
+  return true;
+}
+
+std::chrono::nanoseconds WavSink::delay()
+{
+  if (!frames) {
+    return {};
+  }
+  const std::chrono::nanoseconds ret = start + std::chrono::nanoseconds(frames * 1000000000 / rate) - std::chrono::steady_clock::now();
+  return (ret.count() > 0) ? ret : std::chrono::nanoseconds();
+}
+
+
+#ifdef HAVE_ALSA
+AlsaSink::AlsaSink(const char *device)
+  : device(device)
+{
+}
+
+AlsaSink::~AlsaSink()
+{
+  if (pcm) {
+    snd_pcm_close(pcm);
+  }
+}
+
+bool AlsaSink::open(int channels, int rate)
+{
+  if (pcm) {
+    if (channels == this->channels && rate == this->rate) {
+      return true;
+    }
+    snd_pcm_close(pcm);
+    pcm = nullptr;
+  }
+
+  // non-blocking: write() decides how long to wait for a stalled device
+  int err = snd_pcm_open(&pcm, device.c_str(), SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK);
+  if (err < 0) {
+    fprintf(stderr, "Cannot open audio device %s: %s\n", device.c_str(), snd_strerror(err));
+    pcm = nullptr;
+    return false;
+  }
+  err = snd_pcm_set_params(pcm, SND_PCM_FORMAT_FLOAT_LE, SND_PCM_ACCESS_RW_INTERLEAVED, channels, rate, 1, 100000);  // (allow resampling, 100 ms latency)
+  if (err < 0) {  // TODO? downmix
+    fprintf(stderr, "Audio device %s does not support %d channels at %d Hz: %s\n", device.c_str(), channels, rate, snd_strerror(err));
+    snd_pcm_close(pcm);
+    pcm = nullptr;
+    return false;
+  }
+  this->channels = channels;
+  this->rate = rate;
+  return true;
+}
+
+bool AlsaSink::write(const float *data, size_t frames)
+{
+  const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+  while (frames > 0) {
+    const snd_pcm_sframes_t res = snd_pcm_writei(pcm, data, frames);
+    if (res == -EAGAIN) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;  // stalled
+      }
+      snd_pcm_wait(pcm, 50);
+      continue;
+    } else if (res < 0) {
+      if (snd_pcm_recover(pcm, res, 1) < 0) {  // (underrun, suspend)
+        return false;
+      }
+      continue;
+    }
+    data += res * channels;
+    frames -= res;
+  }
+  return true;
+}
+
+std::chrono::nanoseconds AlsaSink::delay()
+{
+  snd_pcm_sframes_t frames;
+  if (snd_pcm_delay(pcm, &frames) < 0 || frames < 0) {
+    frames = 0;
+  }
+  return std::chrono::nanoseconds((int64_t)frames * 1000000000 / rate);
+}
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+#include <chrono>
+#include <memory>
+#include <string>
+
+class AudioSink {
+public:
+  virtual ~AudioSink() {}
+
+  // false: format not supported (message already printed)
+  virtual bool open(int channels, int rate) = 0;
+
+  // interleaved float; may wait for the device, but not forever. false: error / stalled (samples are lost)
+  virtual bool write(const float *data, size_t frames) = 0;
+
+  // time until a sample written now is played
+  virtual std::chrono::nanoseconds delay() = 0;
+};
+
+// "alsa", "alsa:device" or a filename (.wav)
+std::unique_ptr<AudioSink> create_audio_sink(const char *spec);
+
+// 32-bit float WAV, written in real time (like a device with WAV_BUFFER of buffering), for testing
+class WavSink : public AudioSink {
+public:
+  explicit WavSink(const char *filename);
+  ~WavSink();  // fixes up the header
+
+  bool open(int channels, int rate) override;
+  bool write(const float *data, size_t frames) override;
+  std::chrono::nanoseconds delay() override;
+
+private:
+  std::string filename;
+  FILE *f = nullptr;
+  int channels = 0, rate = 0;
+  uint64_t frames = 0;
+  std::chrono::steady_clock::time_point start;
+};
+
+#ifdef HAVE_ALSA
+typedef struct _snd_pcm snd_pcm_t;
+
+class AlsaSink : public AudioSink {
+public:
+  explicit AlsaSink(const char *device);
+  ~AlsaSink();
+
+  bool open(int channels, int rate) override;
+  bool write(const float *data, size_t frames) override;
+  std::chrono::nanoseconds delay() override;
+
+private:
+  std::string device;
+  snd_pcm_t *pcm = nullptr;
+  int channels = 0, rate = 0;
+};
+#endif
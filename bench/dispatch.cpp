@@ -0,0 +1,114 @@
+// Dispatch of an X event stream through XcbDemux (per-type table, per-window demux), as in MyUI::run_once().
+//   bench/dispatch [events]  events: raw xcb_generic_event_t records (32 bytes each), e.g. a recorded session;
+//                            default: a resize storm over a mosaic of 16 windows (configure / expose bursts, motion, keys)
+#include "../xcbcpp/xcbdemux.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+static const int num_windows = 16;
+static const xcb_window_t first_window = 0x1200001;
+
+using record_t = xcb_generic_event_t;  // (32 bytes, as on the wire)
+
+template <typename Event>
+static void add(std::vector<record_t> &stream, uint8_t type, const Event &ev)
+{
+  static_assert(sizeof(Event) <= sizeof(record_t), "event size");
+  record_t rec = {};
+  memcpy(&rec, &ev, sizeof(Event));
+  rec.response_type = type;
+  stream.push_back(rec);
+}
+
+static std::vector<record_t> resize_storm(int steps)
+{
+  std::vector<record_t> ret;
+  for (int i = 0; i < steps; i++) {
+    for (int w = 0; w < num_windows; w++) {
+      const xcb_window_t win = first_window + w;
+      xcb_configure_notify_event_t cfg = {};
+      cfg.event = cfg.window = win;
+      cfg.width = 480 + i % 64;
+      cfg.height = 270 + i % 36;
+      add(ret, XCB_CONFIGURE_NOTIFY, cfg);
+
+      xcb_expose_event_t expose = {};
+      expose.window = win;
+      expose.count = 1;
+      add(ret, XCB_EXPOSE, expose);
+      expose.count = 0;
+      add(ret, XCB_EXPOSE, expose);
+
+      xcb_property_notify_event_t prop = {};  // (no handler)
+      prop.window = win;
+      add(ret, XCB_PROPERTY_NOTIFY, prop);
+    }
+    xcb_motion_notify_event_t motion = {};
+    motion.event = first_window + i % num_windows;
+    motion.event_x = i % 480;
+    add(ret, XCB_MOTION_NOTIFY, motion);
+    if (i % 32 == 0) {
+      xcb_key_press_event_t key = {};
+      key.event = first_window + i % num_windows;
+      key.detail = 0x41;
+      add(ret, XCB_KEY_PRESS, key);
+    }
+  }
+  return ret;
+}
+
+static std::vector<record_t> load(const char *filename)
+{
+  std::vector<record_t> ret;
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    perror(filename);
+    return ret;
+  }
+  record_t rec;
+  while (fread(&rec, sizeof(rec), 1, f) == 1) {
+    ret.push_back(rec);
+  }
+  fclose(f);
+  return ret;
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<record_t> stream = (argc > 1) ? load(argv[1]) : resize_storm(4096);
+  if (stream.empty()) {
+    fprintf(stderr, "No events.\n");
+    return 1;
+  }
+
+  XcbDemux dmux;
+  std::vector<Connection> conns;
+  uint64_t handled = 0;
+  for (int w = 0; w < num_windows; w++) {
+    const xcb_window_t win = first_window + w;
+    conns.push_back(dmux.on_configure_notify(win, [&](xcb_configure_notify_event_t *ev) { handled += ev->width; }));
+    conns.push_back(dmux.on_expose(win, [&](xcb_expose_event_t *ev) { handled += (ev->count == 0); }));
+    conns.push_back(dmux.on_key_press(win, [&](xcb_key_press_event_t *ev) { handled += ev->detail; }));
+    conns.push_back(dmux.on_motion_notify(win, [&](xcb_motion_notify_event_t *ev) { handled += ev->event_x; }));
+    conns.push_back(dmux.on_client_message(win, [&](xcb_client_message_event_t *ev) { handled++; }));
+  }
+
+  using clock = std::chrono::steady_clock;
+  const int rounds = 200;
+  double best = 1e9;
+  for (int r = 0; r < 5; r++) {
+    const clock::time_point t0 = clock::now();
+    for (int i = 0; i < rounds; i++) {
+      for (record_t &ev : stream) {
+        dmux.emit(&ev);
+      }
+    }
+    const double ns = std::chrono::duration<double, std::nano>(clock::now() - t0).count() / ((double)rounds * stream.size());
+    best = std::min(best, ns);
+  }
+  printf("%zu events, %d windows: %.1f ns/event (best of 5)  [%llu]\n",
+         stream.size(), num_windows, best, (unsigned long long)handled);
+  return 0;
+}
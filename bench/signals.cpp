@@ -0,0 +1,58 @@
+// Signal emit / connect throughput by node storage: heap (one allocation per handler) vs. pool (inline slots, reused chunks)
+//   bench/signals
+#include "../xcbcpp/signals.h"
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+using clock_type = std::chrono::steady_clock;
+
+static double ns_since(clock_type::time_point t0, double n)
+{
+  return std::chrono::duration<double, std::nano>(clock_type::now() - t0).count() / n;
+}
+
+template <typename SignalType>
+static void run(const char *name)
+{
+  const int emits = 20000000, connects = 1000000;
+  uint64_t sum = 0;
+  for (int handlers : { 1, 2, 4 }) {
+    SignalType signal;
+    std::vector<Connection> conns;
+    for (int i = 0; i < handlers; i++) {
+      conns.push_back(signal.connect([&sum, i](int val) { sum += val + i; }));
+    }
+
+    double best = 1e9;
+    for (int r = 0; r < 5; r++) {
+      const clock_type::time_point t0 = clock_type::now();
+      for (int i = 0; i < emits; i++) {
+        signal.emit(i);
+      }
+      best = std::min(best, ns_since(t0, emits));
+    }
+    printf("%s: emit, %d handler(s): %.2f ns\n", name, handlers, best);
+  }
+
+  SignalType signal;
+  double best = 1e9;
+  for (int r = 0; r < 5; r++) {
+    const clock_type::time_point t0 = clock_type::now();
+    for (int i = 0; i < connects; i++) {
+      Connection a = signal.connect([&sum](int val) { sum += val; }),
+                 b = signal.connect([&sum](int val) { sum -= val; });
+      a.disconnect();
+      b.disconnect();
+    }
+    best = std::min(best, ns_since(t0, connects));
+  }
+  printf("%s: connect + disconnect of 2 handlers: %.2f ns  [%llu]\n", name, best, (unsigned long long)sum);
+}
+
+int main()
+{
+  run<Signal<void(int)>>("heap");
+  run<Signal<void(int), void, detail::reduce_use_last<void>, detail::signal_pool_storage<>>>("pool");
+  return 0;
+}
@@ -0,0 +1,294 @@
+#include "colorspace.h"
+#include "libyuv/convert_argb.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+// (FourCC values as in NDIlib_FourCC_video_type_e)
+#define FOURCC_UYVY  0x59565955  // 'UYVY'
+#define FOURCC_UYVA  0x41565955  // 'UYVA'
+#define FOURCC_P216  0x36313250  // 'P216'
+#define FOURCC_PA16  0x36314150  // 'PA16'
+#define FOURCC_BGRA  0x41524742  // 'BGRA'
+#define FOURCC_BGRX  0x58524742  // 'BGRX'
+
+bool parse_colorspace(const char *str, colorspace_t &ret)
+{
+  const char *colon = strchr(str, ':');
+  const size_t len = colon ? (size_t)(colon - str) : strlen(str);
+  if (colon && strcmp(colon, ":full") != 0) {
+    return false;
+  }
+
+  if (len == 4 && strncmp(str, "auto", len) == 0) {
+    ret.matrix = ColorMatrix::AUTO;
+  } else if (len == 5 && strncmp(str, "bt601", len) == 0) {
+    ret.matrix = ColorMatrix::BT601;
+  } else if (len == 5 && strncmp(str, "bt709", len) == 0) {
+    ret.matrix = ColorMatrix::BT709;
+  } else if (len == 6 && strncmp(str, "bt2020", len) == 0) {
+    ret.matrix = ColorMatrix::BT2020;
+  } else {
+    return false;
+  }
+  ret.full_range = (colon != NULL);
+  return true;
+}
+
+colorspace_t resolve_colorspace(colorspace_t cs, int xres, int yres)
+{
+  if (cs.matrix == ColorMatrix::AUTO) {
+    if (xres < 1280 && yres < 720) {
+      cs.matrix = ColorMatrix::BT601;
+    } else if (xres <= 1920 && yres <= 1080) {
+      cs.matrix = ColorMatrix::BT709;
+    } else {
+      cs.matrix = ColorMatrix::BT2020;
+    }
+  }
+  return cs;
+}
+
+const char *colorspace_name(colorspace_t cs)
+{
+  switch (cs.matrix) {
+  case ColorMatrix::BT601: return cs.full_range ? "BT.601 full" : "BT.601 limited";
+  case ColorMatrix::BT709: return cs.full_range ? "BT.709 full" : "BT.709 limited";
+  case ColorMatrix::BT2020: return cs.full_range ? "BT.2020 full" : "BT.2020 limited";
+  default: return "auto";
+  }
+}
+
+const libyuv::YuvConstants *yuv_constants(colorspace_t cs)
+{
+  switch (cs.matrix) {
+  case ColorMatrix::BT601: return cs.full_range ? &libyuv::kYuvJPEGConstants : &libyuv::kYuvI601Constants;
+  case ColorMatrix::BT2020: return cs.full_range ? &libyuv::kYuvV2020Constants : &libyuv::kYuv2020Constants;
+  case ColorMatrix::BT709:
+  default:
+    return cs.full_range ? &libyuv::kYuvF709Constants : &libyuv::kYuvH709Constants;
+  }
+}
+
+static void p216_to_uyvy_row_C(const uint16_t *y, const uint16_t *uv, uint8_t *uyvy, int xres, const uint16_t bias[16])
+{
+  for (int x = 0; x < xres; x += 2) {
+    uyvy[0] = std::min((uv[0] + bias[8 + x % 8]) >> 8, 255);
+    uyvy[1] = std::min((y[0] + bias[x % 8]) >> 8, 255);
+    uyvy[2] = std::min((uv[1] + bias[8 + (x + 1) % 8]) >> 8, 255);
+    uyvy[3] = (x + 1 < xres) ? std::min((y[1] + bias[(x + 1) % 8]) >> 8, 255) : uyvy[1];
+    y += 2;
+    uv += 2;
+    uyvy += 4;
+  }
+}
+
+#ifdef __SSE2__
+// 16 pixels per iteration: saturating add of the bias, high bytes packed, then interleaved as U Y V Y
+static void p216_to_uyvy_row_SSE2(const uint16_t *y, const uint16_t *uv, uint8_t *uyvy, int xres, const uint16_t bias[16])
+{
+  const __m128i bias_y = _mm_loadu_si128((const __m128i *)bias),
+                bias_uv = _mm_loadu_si128((const __m128i *)(bias + 8));
+  int x = 0;
+  for (; x + 16 <= xres; x += 16) {
+    const __m128i y0 = _mm_srli_epi16(_mm_adds_epu16(_mm_loadu_si128((const __m128i *)(y + x)), bias_y), 8),
+                  y1 = _mm_srli_epi16(_mm_adds_epu16(_mm_loadu_si128((const __m128i *)(y + x + 8)), bias_y), 8),
+                  c0 = _mm_srli_epi16(_mm_adds_epu16(_mm_loadu_si128((const __m128i *)(uv + x)), bias_uv), 8),
+                  c1 = _mm_srli_epi16(_mm_adds_epu16(_mm_loadu_si128((const __m128i *)(uv + x + 8)), bias_uv), 8);
+    const __m128i y8 = _mm_packus_epi16(y0, y1),
+                  c8 = _mm_packus_epi16(c0, c1);  // u0 v0 u1 v1 ...
+    _mm_storeu_si128((__m128i *)(uyvy + 2 * x), _mm_unpacklo_epi8(c8, y8));
+    _mm_storeu_si128((__m128i *)(uyvy + 2 * x + 16), _mm_unpackhi_epi8(c8, y8));
+  }
+  p216_to_uyvy_row_C(y + x, uv + x, uyvy + 2 * x, xres - x, bias);  // (x % 8 == 0)
+}
+#endif
+
+void p216_to_uyvy_row(const uint16_t *y, const uint16_t *uv, uint8_t *uyvy, int xres, const uint16_t bias[16])
+{
+#ifdef __SSE2__
+  p216_to_uyvy_row_SSE2(y, uv, uyvy, xres, bias);
+#else
+  p216_to_uyvy_row_C(y, uv, uyvy, xres, bias);
+#endif
+}
+
+static bool bgra_opaque_row_C(const uint8_t *bgra, int width)
+{
+  uint8_t acc = 0xff;
+  for (int x = 0; x < width; x++) {
+    acc &= bgra[4 * x + 3];
+  }
+  return acc == 0xff;
+}
+
+#ifdef __SSE2__
+// AND-reduction of whole pixels, alpha checked once per row
+static bool bgra_opaque_row_SSE2(const uint8_t *bgra, int width)
+{
+  __m128i acc = _mm_set1_epi32(-1);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    acc = _mm_and_si128(acc, _mm_and_si128(_mm_loadu_si128((const __m128i *)(bgra + 4 * x)),
+                                           _mm_loadu_si128((const __m128i *)(bgra + 4 * x + 16))));
+  }
+  acc = _mm_or_si128(acc, _mm_set1_epi32(0x00ffffff));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_set1_epi32(-1))) == 0xffff &&
+         bgra_opaque_row_C(bgra + 4 * x, width - x);
+}
+
+__attribute__((target("avx2")))
+static bool bgra_opaque_row_AVX2(const uint8_t *bgra, int width)
+{
+  __m256i acc = _mm256_set1_epi32(-1);
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    acc = _mm256_and_si256(acc, _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(bgra + 4 * x)),
+                                                 _mm256_loadu_si256((const __m256i *)(bgra + 4 * x + 32))));
+  }
+  acc = _mm256_or_si256(acc, _mm256_set1_epi32(0x00ffffff));
+  return _mm256_movemask_epi8(_mm256_cmpeq_epi8(acc, _mm256_set1_epi32(-1))) == -1 &&
+         bgra_opaque_row_C(bgra + 4 * x, width - x);
+}
+#endif
+
+bool bgra_opaque(const uint8_t *bgra, int stride, int width, int height)
+{
+#ifdef __SSE2__
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  bool (*opaque_row)(const uint8_t *, int) = has_avx2 ? bgra_opaque_row_AVX2 : bgra_opaque_row_SSE2;
+#else
+  bool (*opaque_row)(const uint8_t *, int) = bgra_opaque_row_C;
+#endif
+  for (int y = 0; y < height; y++) { // (stops at the first translucent row)
+    if (!opaque_row(bgra + (size_t)y * stride, width)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// 8x8 Bayer matrix
+static const uint8_t bayer8[8][8] = {
+  {  0, 32,  8, 40,  2, 34, 10, 42 },
+  { 48, 16, 56, 24, 50, 18, 58, 26 },
+  { 12, 44,  4, 36, 14, 46,  6, 38 },
+  { 60, 28, 52, 20, 62, 30, 54, 22 },
+  {  3, 35, 11, 43,  1, 33,  9, 41 },
+  { 51, 19, 59, 27, 49, 17, 57, 25 },
+  { 15, 47,  7, 39, 13, 45,  5, 37 },
+  { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+// row y of P216 (xres x yres) -> BGRA, via one UYVY row (uyvy: (xres + 1) / 2 * 4 bytes)
+void YuvConverter::p216_row(const uint8_t *data, int stride, int xres, int yres, int y, uint8_t *uyvy, uint8_t *dst) const
+{
+  const uint8_t *uv_plane = data + (size_t)stride * yres;
+  uint16_t bias[16];
+  for (int i = 0; i < 8; i++) { // (chroma: pattern of row y + 4, i.e. uncorrelated with luma)
+    bias[i] = (dither) ? bayer8[y % 8][i] * 4 + 2 : 128;
+    bias[8 + i] = (dither) ? bayer8[(y + 4) % 8][i] * 4 + 2 : 128;
+  }
+  p216_to_uyvy_row((const uint16_t *)(data + (size_t)y * stride), (const uint16_t *)(uv_plane + (size_t)y * stride),
+                   uyvy, xres, bias);
+
+  const int res = libyuv::UYVYToARGBMatrix(uyvy, 0, dst, 0, constants, xres, 1);
+  assert(res == 0);
+}
+
+bool YuvConverter::convert_p216(const uint8_t *data, int stride, bool alpha)
+{
+  uint16_t amin = 0xffff;
+  const uint8_t *a_plane = data + (size_t)stride * yres * 2;
+  row.resize((size_t)(xres + 1) / 2 * 4);
+  for (int y = 0; y < yres; y++) {
+    uint8_t *dst = buf.data() + (size_t)y * xres * 4;
+    p216_row(data, stride, xres, yres, y, row.data(), dst);
+    if (alpha) {
+      const uint16_t *a = (const uint16_t *)(a_plane + (size_t)y * stride);
+      for (int x = 0; x < xres; x++) {
+        dst[4 * x + 3] = a[x] >> 8;
+        amin &= a[x];
+      }
+    }
+  }
+  return (amin >> 8) == 0xff;
+}
+
+YuvConverter::view_t YuvConverter::convert(const uint8_t *data, int stride, uint32_t fourcc, int _xres, int _yres)
+{
+  switch (fourcc) {
+  case FOURCC_BGRA:
+    return { data, stride, FrameAlpha::UNKNOWN };  // (not scanned here, see bgra_opaque())
+  case FOURCC_BGRX:
+    return { data, stride, FrameAlpha::NONE };
+  case FOURCC_UYVY:
+  case FOURCC_UYVA:
+  case FOURCC_P216:
+  case FOURCC_PA16:
+    break;
+  default:
+    return { nullptr, 0, FrameAlpha::UNKNOWN };
+  }
+
+  resolve(_xres, _yres);
+  buf.resize((size_t)xres * 4 * yres);
+
+  if (fourcc == FOURCC_P216 || fourcc == FOURCC_PA16) {
+    const bool opaque = convert_p216(data, stride, fourcc == FOURCC_PA16);
+    return { buf.data(), xres * 4, opaque ? FrameAlpha::OPAQUE : FrameAlpha::TRANSLUCENT };
+  }
+
+  const int res = libyuv::UYVYToARGBMatrix(
+    data, stride,
+    buf.data(), xres * 4,
+    constants,
+    xres, yres);
+  assert(res == 0);
+  uint8_t amin = 0xff;
+  if (fourcc == FOURCC_UYVA) { // (alpha plane: xres bytes per row)
+    const uint8_t *a = data + (size_t)stride * yres;
+    for (size_t i = 0; i < (size_t)xres * yres; i++) {
+      buf[4 * i + 3] = a[i];
+      amin &= a[i];
+    }
+  }
+  return { buf.data(), xres * 4, (amin == 0xff) ? FrameAlpha::OPAQUE : FrameAlpha::TRANSLUCENT };
+}
+
+void YuvConverter::resolve(int _xres, int _yres)
+{
+  if (_xres != xres || _yres != yres) { // (single fields: yres is the field height, which still selects the same matrix)
+    xres = _xres;
+    yres = _yres;
+    resolved = resolve_colorspace(requested, xres, yres);
+    constants = yuv_constants(resolved);
+  }
+}
+
+bool YuvConverter::prepare_rows(uint32_t fourcc, int _xres, int _yres)
+{
+  if (fourcc != FOURCC_UYVY && fourcc != FOURCC_P216) {
+    return false;
+  }
+  resolve(_xres, _yres);
+  return true;
+}
+
+void YuvConverter::convert_rows(const uint8_t *data, int stride, uint32_t fourcc, int xres, int yres,
+                                int y0, int rows, uint8_t *dst, int dst_stride) const
+{
+  if (fourcc == FOURCC_UYVY) {
+    const int res = libyuv::UYVYToARGBMatrix(data + (size_t)y0 * stride, stride, dst, dst_stride, constants, xres, rows);
+    assert(res == 0);
+    return;
+  }
+  static thread_local std::vector<uint8_t> uyvy;  // (P216: one row, per thread)
+  uyvy.resize((size_t)(xres + 1) / 2 * 4);
+  for (int y = 0; y < rows; y++) {
+    p216_row(data, stride, xres, yres, y0 + y, uyvy.data(), dst + (size_t)y * dst_stride);
+  }
+}
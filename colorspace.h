@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace libyuv { struct YuvConstants; }
+
+enum class ColorMatrix { AUTO, BT601, BT709, BT2020 };
+
+struct colorspace_t {
+  ColorMatrix matrix = ColorMatrix::AUTO;
+  bool full_range = false;
+};
+
+// "auto", "bt601", "bt709", "bt2020", optionally with ":full" (default: limited range)
+bool parse_colorspace(const char *str, colorspace_t &ret);  // false: unknown
+
+// AUTO by resolution (as NDI does): SD -> BT.601, HD -> BT.709, UHD -> BT.2020
+colorspace_t resolve_colorspace(colorspace_t cs, int xres, int yres);
+const char *colorspace_name(colorspace_t cs);  // e.g. "BT.709 limited"
+
+// (resolved) cs -> one of libyuv's precomputed tables
+const libyuv::YuvConstants *yuv_constants(colorspace_t cs);
+
+// one row of P216 (y: xres samples, uv: xres/2 Cb/Cr pairs) -> UYVY, adding bias[x % 8] (Y) / bias[8 + x % 8] (Cb/Cr) before dropping the low byte
+void p216_to_uyvy_row(const uint16_t *y, const uint16_t *uv, uint8_t *uyvy, int xres, const uint16_t bias[16]);
+
+// all alpha bytes 0xff (AND-reduction, SSE2/AVX2)
+bool bgra_opaque(const uint8_t *bgra, int stride, int width, int height);
+
+// what is known about the 4th byte of a BGRA frame
+enum class FrameAlpha {
+  UNKNOWN,      // (scanned when needed, see bgra_opaque())
+  OPAQUE,       // all alpha 0xff
+  TRANSLUCENT,  // some alpha < 0xff
+  NONE          // BGRX: opaque, but the X bytes are undefined (i.e. not necessarily 0xff)
+};
+
+// YUV frames (UYVY, UYVA, P216, PA16) -> BGRA, with the matrix resolved once per format change; BGRA/BGRX is passed through.
+// 16 bit (P216/PA16) is reduced to 8 bit with an ordered dither (or rounded), row by row right before the matrix conversion.
+class YuvConverter {
+public:
+  void set_dither(bool val) { dither = val; }
+
+  void set_colorspace(colorspace_t cs) {
+    requested = cs;
+    xres = yres = 0;  // (re-resolve)
+  }
+  colorspace_t colorspace() const { return resolved; }  // (of the last converted frame)
+
+  struct view_t {
+    const uint8_t *data;  // nullptr: unsupported fourcc
+    int stride;
+    FrameAlpha alpha;     // YUV: found while converting; BGRA: UNKNOWN
+  };
+  // NOTE: result is valid until the next call
+  view_t convert(const uint8_t *data, int stride, uint32_t fourcc, int xres, int yres);
+
+  // strip-wise, for frames without alpha (UYVY, P216) that are only needed as BGRA while being scaled:
+  // prepare_rows() resolves the matrix (false: other fourcc), then convert_rows() may be called concurrently
+  bool prepare_rows(uint32_t fourcc, int xres, int yres);
+  // rows [y0, y0 + rows) of the xres x yres frame -> BGRA (alpha 0xff), dst points at row y0
+  void convert_rows(const uint8_t *data, int stride, uint32_t fourcc, int xres, int yres,
+                    int y0, int rows, uint8_t *dst, int dst_stride) const;
+
+private:
+  void resolve(int xres, int yres);
+  void p216_row(const uint8_t *data, int stride, int xres, int yres, int y, uint8_t *uyvy, uint8_t *dst) const;
+  bool convert_p216(const uint8_t *data, int stride, bool alpha);  // (returns opaque)
+
+  colorspace_t requested, resolved;
+  bool dither = true;
+  int xres = 0, yres = 0;
+  const libyuv::YuvConstants *constants = nullptr;
+  std::vector<uint8_t> buf;
+  std::vector<uint8_t> row;  // (P216: one UYVY row)
+};
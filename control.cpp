@@ -0,0 +1,88 @@
+#include "control.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <system_error>
+
+ControlSocket::ControlSocket(const char *path, handler_t handler)
+  : path(path), handler(std::move(handler))
+{
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    throw std::runtime_error("Control socket path too long");
+  }
+  strcpy(addr.sun_path, path);
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd == -1) {
+    throw std::system_error(errno, std::generic_category(), "socket failed");
+  }
+
+  unlink(path);  // TODO? check that no other instance is still listening
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+      listen(listen_fd, 4) == -1) {
+    const int code = errno;
+    close(listen_fd);
+    throw std::system_error(code, std::generic_category(), std::string("Could not listen on ") + path);
+  }
+}
+
+ControlSocket::~ControlSocket()
+{
+  for (client_t &client : clients) {
+    close(client.fd);
+  }
+  close(listen_fd);
+  unlink(path.c_str());
+}
+
+void ControlSocket::poll()
+{
+  int fd;
+  while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+    clients.push_back({fd, {}});
+  }
+
+  for (size_t i = 0; i < clients.size(); ) {
+    if (!read_client(clients[i])) {
+      close(clients[i].fd);
+      clients.erase(clients.begin() + i);
+    } else {
+      i++;
+    }
+  }
+}
+
+bool ControlSocket::read_client(client_t &client)
+{
+  char buf[512];
+  ssize_t len;
+  while ((len = read(client.fd, buf, sizeof(buf))) > 0) {
+    client.buf.append(buf, len);
+  }
+  const bool closed = (len == 0 || (errno != EAGAIN && errno != EINTR));
+
+  size_t pos;
+  while ((pos = client.buf.find('\n')) != std::string::npos) {
+    std::string cmd = client.buf.substr(0, pos);
+    client.buf.erase(0, pos + 1);
+    if (!cmd.empty() && cmd.back() == '\r') {
+      cmd.pop_back();
+    }
+
+    std::string reply;
+    handler(cmd, reply);
+    reply += '\n';
+    send(client.fd, reply.data(), reply.size(), MSG_NOSIGNAL | MSG_DONTWAIT);  // (replies are short, ignore partial writes)
+  }
+
+  if (client.buf.size() > 4096) { // no line end in sight
+    return false;
+  }
+  return !closed;
+}
+
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Unix-domain stream socket with a line protocol: every received line is passed to the handler,
+// which fills in a (single line) reply. Never blocks.
+class ControlSocket {
+public:
+  using handler_t = std::function<void(const std::string &cmd, std::string &reply)>;
+
+  ControlSocket(const char *path, handler_t handler);  // (removes stale socket file)
+  ~ControlSocket();
+
+  ControlSocket(const ControlSocket &) = delete;
+  ControlSocket &operator=(const ControlSocket &) = delete;
+
+  // accept new clients, handle complete lines
+  void poll();
+
+private:
+  struct client_t {
+    int fd;
+    std::string buf;
+  };
+  bool read_client(client_t &client);  // false: closed
+
+  std::string path;
+  handler_t handler;
+  int listen_fd;
+  std::vector<client_t> clients;
+};
+
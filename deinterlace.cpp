@@ -0,0 +1,122 @@
+#include "deinterlace.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define COMB_THRESHOLD 12   // per channel, beyond the range spanned by the neighbouring lines
+
+bool parse_deinterlace(const char *str, Deinterlace &ret)
+{
+  if (strcmp(str, "weave") == 0) {
+    ret = Deinterlace::WEAVE;
+  } else if (strcmp(str, "bob") == 0) {
+    ret = Deinterlace::BOB;
+  } else if (strcmp(str, "adaptive") == 0) {
+    ret = Deinterlace::ADAPTIVE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+Deinterlacer::view_t Deinterlacer::process(const uint8_t *data, int stride, int xres, int yres, field_t field, int out_height)
+{
+  if (field == FIELD_NONE) {
+    return {data, stride, yres};
+  }
+  const bool single = (field == FIELD_0 || field == FIELD_1);
+  const int height = frame_height(field, yres),
+            parity = (field == FIELD_1) ? 1 : 0;
+
+  if (mode == Deinterlace::BOB || out_height <= height / 2) {
+    if (single) {
+      return {data, stride, yres};
+    }
+    return {data, 2 * stride, (yres + 1) / 2};  // (field 0)  TODO? alternate fields (would need 2x display rate)
+  }
+
+  const int wstride = xres * 4;
+  if (single) {
+    if (woven_xres != xres || woven_yres != height) {
+      woven.assign((size_t)wstride * height, 0);
+      woven_xres = xres;
+      woven_yres = height;
+    }
+    for (int y = 0; y < yres; y++) {
+      memcpy(&woven[(size_t)(2 * y + parity) * wstride], data + (size_t)y * stride, wstride);
+    }
+    data = woven.data();
+    stride = wstride;
+  }
+
+  if (mode == Deinterlace::WEAVE) {
+    return {data, stride, height};
+  }
+
+  out.resize((size_t)wstride * height);
+  deinterlace_adaptive(data, stride, out.data(), wstride, xres, height, parity);
+  return {out.data(), wstride, height};
+}
+
+// a, b: lines above / below
+static void adaptive_row_C(const uint8_t *a, const uint8_t *m, const uint8_t *b, uint8_t *dst, int width)
+{
+  for (int x = 0; x < width; x++, a += 4, m += 4, b += 4, dst += 4) {
+    bool combed = false;
+    for (int c = 0; c < 4; c++) {
+      const int lo = (a[c] < b[c]) ? a[c] : b[c],
+                hi = (a[c] < b[c]) ? b[c] : a[c];
+      combed |= (m[c] > hi + COMB_THRESHOLD || m[c] < lo - COMB_THRESHOLD);
+    }
+    for (int c = 0; c < 4; c++) {
+      dst[c] = (combed) ? (a[c] + b[c] + 1) / 2 : m[c];
+    }
+  }
+}
+
+#ifdef __SSE2__
+// 4 pixels at a time, same result as adaptive_row_C
+static void adaptive_row_SSE2(const uint8_t *a, const uint8_t *m, const uint8_t *b, uint8_t *dst, int width)
+{
+  const __m128i thresh = _mm_set1_epi8(COMB_THRESHOLD),
+                zero = _mm_setzero_si128();
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128i va = _mm_loadu_si128((const __m128i *)(a + 4 * x)),
+                  vm = _mm_loadu_si128((const __m128i *)(m + 4 * x)),
+                  vb = _mm_loadu_si128((const __m128i *)(b + 4 * x));
+    const __m128i hi = _mm_adds_epu8(_mm_max_epu8(va, vb), thresh),
+                  lo = _mm_subs_epu8(_mm_min_epu8(va, vb), thresh);
+    const __m128i outside = _mm_or_si128(_mm_subs_epu8(vm, hi), _mm_subs_epu8(lo, vm));  // (non-zero bytes)
+    const __m128i still = _mm_cmpeq_epi32(outside, zero);  // per pixel
+    const __m128i res = _mm_or_si128(_mm_and_si128(still, vm), _mm_andnot_si128(still, _mm_avg_epu8(va, vb)));
+    _mm_storeu_si128((__m128i *)(dst + 4 * x), res);
+  }
+  if (x < width) {
+    adaptive_row_C(a + 4 * x, m + 4 * x, b + 4 * x, dst + 4 * x, width - x);
+  }
+}
+#define adaptive_row adaptive_row_SSE2
+#else
+#define adaptive_row adaptive_row_C
+#endif
+
+void deinterlace_adaptive(const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride, int width, int height, int keep_parity)
+{
+  for (int y = 0; y < height; y++) {
+    const uint8_t *m = src + (size_t)y * src_stride;
+    uint8_t *d = dst + (size_t)y * dst_stride;
+    if ((y & 1) == keep_parity) {
+      memcpy(d, m, (size_t)width * 4);
+      continue;
+    }
+    // (edges: both neighbours are the same line)
+    const uint8_t *a = (y > 0) ? m - src_stride : m + src_stride,
+                  *b = (y + 1 < height) ? m + src_stride : m - src_stride;
+    if (height == 1) {
+      a = b = m;
+    }
+    adaptive_row(a, m, b, d, width);
+  }
+}
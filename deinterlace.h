@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// field structure of a frame (cf. NDIlib_frame_format_type_e)
+enum field_t {
+  FIELD_NONE,         // progressive
+  FIELD_INTERLEAVED,  // both fields, field 0 on even lines
+  FIELD_0, FIELD_1    // single field, yres is the field height
+};
+
+enum class Deinterlace { WEAVE, BOB, ADAPTIVE };
+
+bool parse_deinterlace(const char *str, Deinterlace &ret);  // false: unknown mode
+
+// BGRA frames -> progressive view, which is then scaled for display.
+// Whenever the output is not taller than a single field, only one field is used, simply by doubling the stride:
+// the scaler does the line doubling (bilinear: InterpolateRow), i.e. downscaled previews cost the same as progressive ones.
+class Deinterlacer {
+public:
+  Deinterlacer(Deinterlace mode = Deinterlace::ADAPTIVE) : mode(mode) { }
+
+  void set_mode(Deinterlace val) { mode = val; }
+
+  static int frame_height(field_t field, int yres) {
+    return (field == FIELD_0 || field == FIELD_1) ? 2 * yres : yres;
+  }
+
+  struct view_t {
+    const uint8_t *data;
+    int stride, rows;   // (rows < frame_height(): to be stretched)
+  };
+  // result stays valid until the next process()
+  view_t process(const uint8_t *data, int stride, int xres, int yres, field_t field, int out_height);
+
+private:
+  Deinterlace mode;
+
+  std::vector<uint8_t> woven;  // single fields are collected here (other field is the previous one)
+  int woven_xres = 0, woven_yres = 0;
+  std::vector<uint8_t> out;
+};
+
+// motion-adaptive: lines not of keep_parity are rebuilt from their neighbours where the frame combs
+// (i.e. the picture moved between the fields), and kept (= weave) elsewhere
+void deinterlace_adaptive(const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride, int width, int height, int keep_parity);
@@ -0,0 +1,171 @@
+#include "discovery.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <stdexcept>
+
+static std::string cache_dir()
+{
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  if (xdg && *xdg == '/') {
+    return xdg;
+  }
+  const char *home = getenv("HOME");
+  if (home && *home) {
+    return std::string(home) + "/.cache";
+  }
+  return {};
+}
+
+SourceCache::SourceCache()
+{
+  const std::string dir = cache_dir();
+  if (dir.empty()) {
+    return;
+  }
+  path = dir + "/xndiview/sources";
+  load();
+}
+
+SourceCache::SourceCache(const char *path)
+  : path(path)
+{
+  load();
+}
+
+void SourceCache::load()
+{
+  FILE *f = fopen(path.c_str(), "r");
+  if (!f) {
+    return;
+  }
+  char *line = NULL;
+  size_t len = 0;
+  ssize_t res;
+  while ((res = getline(&line, &len, f)) > 0) {
+    if (line[res - 1] == '\n') {
+      line[--res] = 0;
+    }
+    const char *sep = strchr(line, '\t');
+    if (!sep || sep == line || !sep[1]) {
+      continue;  // (ignore broken lines)
+    }
+    entries.emplace_back(std::string(line, sep - line), std::string(sep + 1));
+  }
+  free(line);
+  fclose(f);
+}
+
+std::string SourceCache::lookup(const std::string &name) const
+{
+  for (const auto &e : entries) {
+    if (e.first == name) {
+      return e.second;
+    }
+  }
+  return {};
+}
+
+bool SourceCache::update(const NDIlib_source_t *sources, uint32_t num)
+{
+  bool changed = false;
+  for (uint32_t i = 0; i < num; i++) {
+    const char *name = sources[i].p_ndi_name,
+               *url = sources[i].p_url_address;
+    if (!name || !*name || !url || !*url ||
+        strpbrk(name, "\t\n") || strpbrk(url, "\t\n")) {
+      continue;
+    }
+
+    bool found = false;
+    for (auto &e : entries) {
+      if (e.first == name) {
+        if (e.second != url) {
+          e.second = url;
+          changed = true;
+        }
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      entries.emplace_back(name, url);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+bool SourceCache::forget(const std::string &name)
+{
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (it->first == name) {
+      entries.erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+void SourceCache::save() const
+{
+  if (path.empty()) {
+    return;
+  }
+  const size_t pos = path.rfind('/');
+  mkdir(path.substr(0, path.rfind('/', pos - 1)).c_str(), 0700);  // (~/.cache might not exist yet)
+  mkdir(path.substr(0, pos).c_str(), 0700);
+
+  // write + rename: concurrent instances (or readers) never see a partial file
+  const std::string tmp = path + "." + std::to_string(getpid());
+  FILE *f = fopen(tmp.c_str(), "w");
+  if (!f) {
+    return;
+  }
+  for (const auto &e : entries) {
+    fprintf(f, "%s\t%s\n", e.first.c_str(), e.second.c_str());
+  }
+  if (fclose(f) != 0 || rename(tmp.c_str(), path.c_str()) != 0) {
+    unlink(tmp.c_str());
+  }
+}
+
+
+SourceFinder::SourceFinder()
+{
+  finder = NDIlib_find_create_v2();
+  if (!finder) {
+    throw std::runtime_error("NDIlib_find_create_v2 failed");
+  }
+}
+
+SourceFinder::~SourceFinder()
+{
+  NDIlib_find_destroy(finder);
+}
+
+void SourceFinder::wait_settled(uint32_t first_ms, uint32_t settle_ms, uint32_t max_ms)
+{
+  using clock = std::chrono::steady_clock;
+  const clock::time_point end = clock::now() + std::chrono::milliseconds(max_ms);
+
+  if (!wait(first_ms)) {
+    return;  // nothing at all
+  }
+  while (clock::now() < end && wait(settle_ms)) { }
+}
+
+std::string SourceFinder::url_of(const std::string &name)
+{
+  uint32_t num;
+  const NDIlib_source_t *src = sources(num);
+  for (uint32_t i = 0; i < num; i++) {
+    if (src[i].p_ndi_name && name == src[i].p_ndi_name) {
+      return (src[i].p_url_address) ? src[i].p_url_address : "";
+    }
+  }
+  return {};
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Processing.NDI.Lib.h>
+#include <string>
+#include "srctable.h"  // source_list_t
+
+// NDI name -> url ("ip:port") as last seen by discovery, persisted in $XDG_CACHE_HOME/xndiview/sources
+// (or ~/.cache/...), one "name<TAB>url" per line. Entries are only removed when found stale.
+class SourceCache {
+public:
+  SourceCache();  // (missing or unreadable file: empty cache)
+  explicit SourceCache(const char *path);  // same format, e.g. fake source table
+
+  const source_list_t &list() const { return entries; }
+
+  std::string lookup(const std::string &name) const;  // empty: unknown
+
+  // true: anything changed
+  bool update(const NDIlib_source_t *sources, uint32_t num);
+  bool forget(const std::string &name);
+
+  void save() const;  // (errors are ignored, it's only a cache)
+
+private:
+  void load();
+
+  std::string path;
+  source_list_t entries;
+};
+
+// NDIlib_find_* wrapper (discovery runs in SDK threads)
+class SourceFinder {
+public:
+  SourceFinder();
+  ~SourceFinder();
+
+  SourceFinder(const SourceFinder &) = delete;
+  SourceFinder &operator=(const SourceFinder &) = delete;
+
+  // true: source list changed (timeout_ms = 0: just check)
+  bool wait(uint32_t timeout_ms) {
+    return NDIlib_find_wait_for_sources(finder, timeout_ms);
+  }
+
+  // valid until next call
+  const NDIlib_source_t *sources(uint32_t &num) {
+    num = 0;
+    return NDIlib_find_get_current_sources(finder, &num);
+  }
+
+  // waits up to first_ms for the first sources, then until no more changes arrive for settle_ms (but max_ms in total)
+  void wait_settled(uint32_t first_ms, uint32_t settle_ms, uint32_t max_ms);
+
+  // url of name in current list, empty: not (yet) seen
+  std::string url_of(const std::string &name);
+
+private:
+  NDIlib_find_instance_t finder;
+};
@@ -0,0 +1,106 @@
+#include "frc.h"
+
+#define BLEND_MIN   32   // closer than 1/8 of a frame: just repeat
+#define OFFSET_RELAX std::chrono::microseconds(20)  // per frame, follows clock drift / latency increase
+
+using ticks_100ns = std::chrono::duration<int64_t, std::ratio<1, 10000000>>;
+
+FrcScheduler::FrcScheduler(double hz)
+  : tick_period(std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / hz))),
+    next_tick(clock::now())
+{
+}
+
+int FrcScheduler::push(int64_t timestamp, int fps_n, int fps_d, clock::time_point arrival)
+{
+  if (fps_n > 0 && fps_d > 0) {
+    period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>((double)fps_d / fps_n));
+  }
+
+  clock::time_point show_at = arrival;
+  if (!timestamp) {
+    reset();  // (nothing to interpolate with)
+  } else {
+    const clock::duration src = std::chrono::duration_cast<clock::duration>(ticks_100ns(timestamp)),
+                          transit = arrival.time_since_epoch() - src;
+    if (have_offset && (timestamp <= last_ts || transit > offset + std::chrono::seconds(1))) {
+      reset();  // timestamps jumped (e.g. other source)
+    }
+    if (!have_offset || transit < offset) {
+      offset = transit;
+      have_offset = true;
+    } else {
+      offset += OFFSET_RELAX;
+    }
+    last_ts = timestamp;
+    show_at = clock::time_point(src + offset + period);
+  }
+
+  newest = (newest + 1) % num_slots;
+  slots[newest] = {true, show_at};
+  return newest;
+}
+
+void FrcScheduler::reset()
+{
+  for (slot_t &s : slots) {
+    s.used = false;
+  }
+  have_offset = false;
+}
+
+bool FrcScheduler::tick(pick_t &ret, clock::time_point now)
+{
+  if (now < next_tick || newest < 0) {
+    return false;
+  }
+  next_tick += tick_period;
+  if (next_tick <= now) { // fell behind: no catch-up
+    next_tick = now + tick_period;
+  }
+
+  // a: latest frame already due, b: first frame after it
+  int a = -1, b = -1;
+  for (int i = 0; i < num_slots; i++) {
+    const slot_t &s = slots[i];
+    if (!s.used) {
+      continue;
+    }
+    if (s.show_at <= now) {
+      if (a < 0 || s.show_at > slots[a].show_at) {
+        a = i;
+      }
+    } else if (b < 0 || s.show_at < slots[b].show_at) {
+      b = i;
+    }
+  }
+
+  ret = {};
+  if (a < 0) { // (start: nothing due yet)
+    ret.a = b;
+    return true;
+  }
+  ret.a = a;
+  if (b < 0) {
+    return true;
+  }
+
+  const int frac = (int)(256 * (now - slots[a].show_at) / (slots[b].show_at - slots[a].show_at));
+  if (frac < BLEND_MIN) {
+    // just a
+  } else if (frac > 256 - BLEND_MIN) {
+    ret.a = b;
+  } else {
+    ret.b = b;
+    ret.frac = frac;
+  }
+  return true;
+}
+
+int FrcScheduler::until_tick(clock::time_point now) const
+{
+  if (next_tick <= now) {
+    return 0;
+  }
+  return (int)std::chrono::duration_cast<std::chrono::milliseconds>(next_tick - now + std::chrono::microseconds(999)).count();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+// Frame-rate conversion: maps source frames onto display refresh ticks.
+// Source timestamps (NDI: 100 ns units) are mapped to the local clock by the smallest transit offset seen so far,
+// plus one source frame of latency, so that the later frame of a pair has (usually) arrived by its tick.
+// Per tick, the nearest frame is repeated, or the two around the tick are blended by their distance;
+// frames that fall between two ticks are dropped.
+class FrcScheduler {
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr int num_slots = 3;  // (caller keeps one scaled image per slot)
+
+  explicit FrcScheduler(double hz);
+
+  // timestamp 0: untimed (e.g. replay), shown from the next tick on; returns slot for the frame
+  int push(int64_t timestamp, int fps_n, int fps_d, clock::time_point arrival = clock::now());
+
+  struct pick_t {
+    int a = -1, b = -1;   // b = -1: only a (repeat)
+    int frac = 0;         // weight of b: 1..255
+
+    bool operator==(const pick_t &rhs) const { return a == rhs.a && b == rhs.b && frac == rhs.frac; }
+  };
+
+  // false: no tick due (yet)
+  bool tick(pick_t &ret, clock::time_point now = clock::now());
+
+  int until_tick(clock::time_point now = clock::now()) const;  // in ms, rounded up
+
+private:
+  void reset();
+
+  const clock::duration tick_period;
+  clock::time_point next_tick;
+
+  struct slot_t {
+    bool used = false;
+    clock::time_point show_at;
+  } slots[num_slots];
+  int newest = -1;
+
+  int64_t last_ts = 0;  // in 100 ns
+  clock::duration offset{}, period{};
+  bool have_offset = false;
+};
@@ -0,0 +1,289 @@
+#include "lut3d.h"
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+Lut3d::Lut3d(const char *filename)
+{
+  load(filename);
+}
+
+// NOTE: keywords as in the Adobe Cube spec (1.0) and Resolve (LUT_*_INPUT_RANGE, 1D shaper before the 3D data)
+void Lut3d::load(const char *filename)
+{
+  FILE *f = fopen(filename, "r");
+  if (!f) {
+    throw std::system_error(errno, std::generic_category(), std::string("Could not open ") + filename);
+  }
+
+  int size1 = 0, line_no = 0;
+  float domain_min[3] = {0, 0, 0}, domain_max[3] = {1, 1, 1};
+  float range1[2] = {0, 1}, range3[2] = {0, 1};
+  bool has_domain = false, has_range1 = false, has_range3 = false;
+  std::vector<float> data;  // (r, g, b) lines: 1D entries first, then 3D
+
+  char *line = NULL;
+  size_t line_len = 0;
+  std::string error;
+  while (getline(&line, &line_len, f) != -1) {
+    line_no++;
+    char *p = line + strspn(line, " \t\r\n");
+    if (!*p || *p == '#') {
+      continue;
+    }
+    float v[3];
+    if ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.') {
+      if (sscanf(p, "%f %f %f", &v[0], &v[1], &v[2]) != 3) {
+        error = "bad data line";
+        break;
+      }
+      data.insert(data.end(), v, v + 3);
+    } else if (strncmp(p, "TITLE", 5) == 0) {
+      // (ignored)
+    } else if (sscanf(p, "LUT_1D_SIZE %d", &size1) == 1) {
+      if (size1 < 2 || size1 > 65536) {
+        error = "bad LUT_1D_SIZE";
+        break;
+      }
+    } else if (sscanf(p, "LUT_3D_SIZE %d", &size3) == 1) {
+      if (size3 < 2 || size3 > 256) {
+        error = "bad LUT_3D_SIZE";
+        break;
+      }
+    } else if (sscanf(p, "DOMAIN_MIN %f %f %f", &domain_min[0], &domain_min[1], &domain_min[2]) == 3 ||
+               sscanf(p, "DOMAIN_MAX %f %f %f", &domain_max[0], &domain_max[1], &domain_max[2]) == 3) {
+      has_domain = true;
+    } else if (sscanf(p, "LUT_1D_INPUT_RANGE %f %f", &range1[0], &range1[1]) == 2) {
+      has_range1 = true;
+    } else if (sscanf(p, "LUT_3D_INPUT_RANGE %f %f", &range3[0], &range3[1]) == 2) {
+      has_range3 = true;
+    } else {
+      error = "unknown keyword";
+      break;
+    }
+  }
+  free(line);
+  fclose(f);
+
+  if (error.empty()) {
+    if (!size1 && !size3) {
+      error = "no LUT_1D_SIZE or LUT_3D_SIZE";
+    } else if (data.size() != 3 * ((size_t)size1 + (size_t)size3 * size3 * size3)) {
+      error = "wrong number of entries";
+    }
+    line_no = 0;
+  }
+  if (!error.empty()) {
+    throw std::runtime_error(std::string("Bad .cube file ") + filename + ": " + error +
+                             (line_no ? " (line " + std::to_string(line_no) + ")" : ""));
+  }
+
+  // input domain (per r, g, b) of the first stage: DOMAIN_* (1.0) or LUT_*_INPUT_RANGE (Resolve)
+  float min1[3], max1[3], min3[3], max3[3];
+  for (int c = 0; c < 3; c++) {
+    min1[c] = has_range1 ? range1[0] : domain_min[c];
+    max1[c] = has_range1 ? range1[1] : domain_max[c];
+    min3[c] = has_range3 ? range3[0] : (!size1 && has_domain) ? domain_min[c] : 0.0f;
+    max3[c] = has_range3 ? range3[1] : (!size1 && has_domain) ? domain_max[c] : 1.0f;
+    if (!(max1[c] > min1[c]) || !(max3[c] > min3[c])) {
+      throw std::runtime_error(std::string("Bad .cube file ") + filename + ": empty input range");
+    }
+  }
+
+  // bake the shaper into per-byte tables (c: r, g, b; byte position in BGRX: 2 - c)
+  for (int c = 0; c < 3; c++) {
+    for (int i = 0; i < 256; i++) {
+      float x = i / 255.0f;
+      if (size1) {
+        const float t = std::min(std::max((x - min1[c]) / (max1[c] - min1[c]) * (size1 - 1), 0.0f), (float)(size1 - 1));
+        const int j = std::min((int)t, size1 - 2);
+        x = data[3 * j + c] + (t - j) * (data[3 * (j + 1) + c] - data[3 * j + c]);
+      }
+      if (!size3) {
+        table1d[2 - c][i] = (uint8_t)std::min(std::max(lrintf(x * 255.0f), 0L), 255L);
+        continue;
+      }
+      const float t = std::min(std::max((x - min3[c]) / (max3[c] - min3[c]) * (size3 - 1), 0.0f), (float)(size3 - 1));
+      const int j = std::min((int)t, size3 - 2);
+      frac[2 - c][i] = t - j;
+      offs[2 - c][i] = j * 4 * (c == 0 ? 1 : c == 1 ? size3 : size3 * size3);
+    }
+  }
+  if (!size3) {
+    return;
+  }
+  delta[2] = 4;
+  delta[1] = 4 * size3;
+  delta[0] = 4 * size3 * size3;
+
+  const size_t num = (size_t)size3 * size3 * size3;
+  const float *src = data.data() + 3 * size1;
+  grid.resize(4 * num);
+  for (size_t i = 0; i < num; i++) {
+    grid[4 * i + 0] = src[3 * i + 2] * 255.0f;
+    grid[4 * i + 1] = src[3 * i + 1] * 255.0f;
+    grid[4 * i + 2] = src[3 * i + 0] * 255.0f;
+    grid[4 * i + 3] = 0;
+  }
+}
+
+// sorted fractions f1 >= f2 >= f3 select the tetrahedron:
+//   base, base + d(f1), base + d(f1) + d(f2), base + d(all)  with weights  1 - f1, f1 - f2, f2 - f3, f3
+// (on ties the ambiguous corner gets weight 0)
+struct tetra_t {
+  int32_t base, o1, o2, o3;
+  float w[4];
+};
+
+static inline tetra_t tetra_setup(uint32_t px, const int32_t (*offs)[256], const float (*frac)[256], const int32_t *delta)
+{
+  const int b = px & 0xff, g = (px >> 8) & 0xff, r = (px >> 16) & 0xff;
+  const float fb = frac[0][b], fg = frac[1][g], fr = frac[2][r];
+
+  const float fmax = std::max(std::max(fb, fg), fr),
+              fmin = std::min(std::min(fb, fg), fr),
+              fmid = fb + fg + fr - fmax - fmin;
+  const int32_t dmax = (fr >= fg && fr >= fb) ? delta[2] : (fg >= fb) ? delta[1] : delta[0],
+                dmin = (fr <= fg && fr <= fb) ? delta[2] : (fg <= fb) ? delta[1] : delta[0],
+                dall = delta[0] + delta[1] + delta[2];
+  return {offs[0][b] + offs[1][g] + offs[2][r], dmax, dall - dmin, dall,
+          {1.0f - fmax, fmax - fmid, fmid - fmin, fmin}};
+}
+
+#ifdef __SSE2__
+// one pixel per iteration, all components at once (grid entries are 16 byte)
+static void apply_row_SSE2(const uint32_t *src, uint32_t *dst, int n,
+                           const float *grid, const int32_t (*offs)[256], const float (*frac)[256], const int32_t *delta)
+{
+  for (int i = 0; i < n; i++) {
+    const tetra_t t = tetra_setup(src[i], offs, frac, delta);
+    const float *c0 = grid + t.base;
+    __m128 v = _mm_mul_ps(_mm_loadu_ps(c0), _mm_set1_ps(t.w[0]));
+    v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(c0 + t.o1), _mm_set1_ps(t.w[1])));
+    v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(c0 + t.o2), _mm_set1_ps(t.w[2])));
+    v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(c0 + t.o3), _mm_set1_ps(t.w[3])));
+    const __m128i v32 = _mm_cvtps_epi32(v),
+                  v16 = _mm_packs_epi32(v32, v32);
+    dst[i] = ((uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(v16, v16)) & 0xffffff) | (src[i] & 0xff000000);
+  }
+}
+
+// eight pixels per iteration: table lookups are gathered, tetrahedron selection is branchless, corner entries are loaded whole
+__attribute__((target("avx2")))
+static void apply_row_AVX2(const uint32_t *src, uint32_t *dst, int n,
+                           const float *grid, const int32_t (*offs)[256], const float (*frac)[256], const int32_t *delta)
+{
+  const __m256i mask8 = _mm256_set1_epi32(0xff),
+                alpha = _mm256_set1_epi32((int)0xff000000),
+                d_b = _mm256_set1_epi32(delta[0]), d_g = _mm256_set1_epi32(delta[1]), d_r = _mm256_set1_epi32(delta[2]),
+                d_all = _mm256_set1_epi32(delta[0] + delta[1] + delta[2]);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i px = _mm256_loadu_si256((const __m256i *)(src + i)),
+                  b = _mm256_and_si256(px, mask8),
+                  g = _mm256_and_si256(_mm256_srli_epi32(px, 8), mask8),
+                  r = _mm256_and_si256(_mm256_srli_epi32(px, 16), mask8);
+    const __m256 fb = _mm256_i32gather_ps(frac[0], b, 4),
+                 fg = _mm256_i32gather_ps(frac[1], g, 4),
+                 fr = _mm256_i32gather_ps(frac[2], r, 4);
+    const __m256i base = _mm256_add_epi32(_mm256_add_epi32(_mm256_i32gather_epi32(offs[0], b, 4),
+                                                           _mm256_i32gather_epi32(offs[1], g, 4)),
+                                          _mm256_i32gather_epi32(offs[2], r, 4));
+
+    const __m256 fmax = _mm256_max_ps(_mm256_max_ps(fb, fg), fr),
+                 fmin = _mm256_min_ps(_mm256_min_ps(fb, fg), fr),
+                 fmid = _mm256_sub_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(fb, fg), fr), fmax), fmin);
+    // (same choices as tetra_setup)
+    const __m256i r_max = _mm256_castps_si256(_mm256_and_ps(_mm256_cmp_ps(fr, fg, _CMP_GE_OQ), _mm256_cmp_ps(fr, fb, _CMP_GE_OQ))),
+                  g_max = _mm256_castps_si256(_mm256_cmp_ps(fg, fb, _CMP_GE_OQ)),
+                  r_min = _mm256_castps_si256(_mm256_and_ps(_mm256_cmp_ps(fr, fg, _CMP_LE_OQ), _mm256_cmp_ps(fr, fb, _CMP_LE_OQ))),
+                  g_min = _mm256_castps_si256(_mm256_cmp_ps(fg, fb, _CMP_LE_OQ));
+    const __m256i c1 = _mm256_add_epi32(base, _mm256_blendv_epi8(_mm256_blendv_epi8(d_b, d_g, g_max), d_r, r_max)),
+                  c2 = _mm256_sub_epi32(_mm256_add_epi32(base, d_all), _mm256_blendv_epi8(_mm256_blendv_epi8(d_b, d_g, g_min), d_r, r_min)),
+                  c3 = _mm256_add_epi32(base, d_all);
+    const __m256 w0 = _mm256_sub_ps(one, fmax),
+                 w1 = _mm256_sub_ps(fmax, fmid),
+                 w2 = _mm256_sub_ps(fmid, fmin),
+                 w3 = fmin;
+
+    // corners: whole entries (b, g, r, 0) with one 16 byte load each, two pixels per register
+    alignas(32) int32_t idx[4][8];
+    _mm256_store_si256((__m256i *)idx[0], base);
+    _mm256_store_si256((__m256i *)idx[1], c1);
+    _mm256_store_si256((__m256i *)idx[2], c2);
+    _mm256_store_si256((__m256i *)idx[3], c3);
+    __m256i v32[4];
+    for (int p = 0; p < 8; p += 2) {
+      const __m256i sel = _mm256_setr_epi32(p, p, p, p, p + 1, p + 1, p + 1, p + 1);
+      __m256 v = _mm256_mul_ps(_mm256_loadu2_m128(grid + idx[0][p + 1], grid + idx[0][p]), _mm256_permutevar8x32_ps(w0, sel));
+      v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_loadu2_m128(grid + idx[1][p + 1], grid + idx[1][p]), _mm256_permutevar8x32_ps(w1, sel)));
+      v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_loadu2_m128(grid + idx[2][p + 1], grid + idx[2][p]), _mm256_permutevar8x32_ps(w2, sel)));
+      v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_loadu2_m128(grid + idx[3][p + 1], grid + idx[3][p]), _mm256_permutevar8x32_ps(w3, sel)));
+      v32[p / 2] = _mm256_cvtps_epi32(v);
+    }
+    // (lanes: p0 p2 p4 p6 | p1 p3 p5 p7)
+    const __m256i p8 = _mm256_packus_epi16(_mm256_packs_epi32(v32[0], v32[1]), _mm256_packs_epi32(v32[2], v32[3])),
+                  out = _mm256_permutevar8x32_epi32(p8, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(out, _mm256_and_si256(px, alpha)));
+  }
+  apply_row_SSE2(src + i, dst + i, n - i, grid, offs, frac, delta);
+}
+#else
+static void apply_row_C(const uint32_t *src, uint32_t *dst, int n,
+                        const float *grid, const int32_t (*offs)[256], const float (*frac)[256], const int32_t *delta)
+{
+  for (int i = 0; i < n; i++) {
+    const tetra_t t = tetra_setup(src[i], offs, frac, delta);
+    const float *c0 = grid + t.base, *c1 = c0 + t.o1, *c2 = c0 + t.o2, *c3 = c0 + t.o3;
+    uint32_t out = src[i] & 0xff000000;
+    for (int k = 0; k < 3; k++) {
+      const float v = c0[k] * t.w[0] + c1[k] * t.w[1] + c2[k] * t.w[2] + c3[k] * t.w[3];
+      out |= (uint32_t)std::min(std::max(lrintf(v), 0L), 255L) << (8 * k);
+    }
+    dst[i] = out;
+  }
+}
+#endif
+
+void lut3d_apply_row(const uint32_t *src, uint32_t *dst, int n,
+                     const float *grid, const int32_t (*offs)[256], const float (*frac)[256], const int32_t *delta)
+{
+#ifdef __SSE2__
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    apply_row_AVX2(src, dst, n, grid, offs, frac, delta);
+  } else {
+    apply_row_SSE2(src, dst, n, grid, offs, frac, delta);
+  }
+#else
+  apply_row_C(src, dst, n, grid, offs, frac, delta);
+#endif
+}
+
+void Lut3d::apply_rows(uint8_t *row, int stride, int width, int rows) const
+{
+  for (int y = 0; y < rows; y++, row += stride) {
+    uint32_t *px = (uint32_t *)row;
+    if (size3) {
+      lut3d_apply_row(px, px, width, grid.data(), offs, frac, delta);
+      continue;
+    }
+    for (int x = 0; x < width; x++) {
+      const uint32_t v = px[x];
+      px[x] = (v & 0xff000000) |
+              ((uint32_t)table1d[2][(v >> 16) & 0xff] << 16) |
+              ((uint32_t)table1d[1][(v >> 8) & 0xff] << 8) |
+              table1d[0][v & 0xff];
+    }
+  }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Display LUT from a .cube file: 3D (with optional 1D shaper, as written by Resolve) or 1D only.
+// apply_rows() maps 8 bit BGRX/BGRA in place (alpha is kept), 3D with tetrahedral interpolation;
+// thread-safe, i.e. called per render strip from the worker pool.
+class Lut3d {
+public:
+  explicit Lut3d(const char *filename);  // throws on error
+
+  int size() const { return size3; }  // (0: 1D only)
+
+  void apply_rows(uint8_t *row, int stride, int width, int rows) const;
+
+private:
+  void load(const char *filename);
+
+  int size3 = 0;
+
+  // per input byte (0: b, 1: g, 2: r), shaper and domain already applied:
+  //   grid offset (lower corner) and fraction towards the next grid point
+  int32_t offs[3][256];
+  float frac[3][256];
+  int32_t delta[3];              // (next grid point along the axis)
+  std::vector<float> grid;       // size3^3 x (b, g, r, 0), scaled to 0..255; r fastest, then g, then b
+  uint8_t table1d[3][256];       // (1D only)
+};
+
+// tetrahedral interpolation of n pixels, src and dst may be the same
+void lut3d_apply_row(const uint32_t *src, uint32_t *dst, int n,
+                     const float *grid, const int32_t (*offs)[256], const float (*frac)[256], const int32_t *delta);
@@ -1,75 +1,541 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <Processing.NDI.Lib.h>
-#include <unistd.h>  // sleep
+#include <unistd.h>
+#include <getopt.h>
 #include "myui.h"
+#include "replay.h"
+#include "recorder.h"
+#include "player.h"
+#include "pipeout.h"
+#include "control.h"
+#include "audio.h"
+#include "meters.h"
+#include "colorspace.h"
+#include "scopes.h"
+#include "discovery.h"
+#include "srctable.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <algorithm>
+#include <chrono>
 
+// (pipe output may hold frames until the reader has consumed them; source switch needs one more)
+#define NUM_VF  (3 + (int)PipeOutput::max_frames)
 int cur_vf = -1;
-NDIlib_video_frame_v2_t video_frame[2] = {};
+NDIlib_video_frame_v2_t video_frame[NUM_VF] = {};
+NDIlib_recv_instance_t vf_recv[NUM_VF] = {};  // owner of frame; NULL: slot unused
+bool vf_held[NUM_VF] = {};
 bool opt_verbose = false;
 
+NDIlib_recv_instance_t recv = NULL, pending_recv = NULL;  // pending: switch as soon as it delivers the first frame
+std::string recv_name, pending_name;
+std::vector<NDIlib_recv_instance_t> retired_recvs;  // destroyed once none of their frames is used anymore
+NDIlib_tally_t tally = {};
+bool quit = false;
+
+struct {
+  uint64_t frames = 0;    // received video frames
+  uint64_t switches = 0;
+} stats;
+
+// -v: time to first frame, per startup phase
+const std::chrono::steady_clock::time_point startup_t0 = std::chrono::steady_clock::now();
+
+void startup_phase(const char *name, std::chrono::steady_clock::time_point at = std::chrono::steady_clock::now())
+{
+  if (opt_verbose) {
+    printf("Startup: %s after %.1f ms.\n", name, std::chrono::duration<double, std::milli>(at - startup_t0).count());
+  }
+}
+
+std::unique_ptr<Recorder> recorder;
+std::unique_ptr<PipeOutput> pipeout;
+std::unique_ptr<ReplayRing> replay;
+std::unique_ptr<AudioOutput> audio;
+std::unique_ptr<AudioMeters> meters;
+std::unique_ptr<WorkerPool> workers;
+YuvConverter yuv;  // (UYVY sources)
+std::unique_ptr<Scopes> scopes;
+bool frozen = false;
+uint64_t frozen_seq = 0;
+
+std::unique_ptr<SourceCache> source_cache;
+std::unique_ptr<SourceFinder> finder;  // (only while the startup source is not yet validated)
+std::unique_ptr<SourceTableReader> srctable;  // instead of finder, when the discovery daemon runs
+std::string cached_name, cached_url;    // cached_url empty: not connected by cached address (anymore)
+std::chrono::steady_clock::time_point cached_deadline;
+
+void show_replay(MyUI &ui)
+{
+  // assert(replay && !replay->empty());
+  if (frozen_seq < replay->first()) {  // already overwritten
+    frozen_seq = replay->first();
+  } else if (frozen_seq > replay->last()) {
+    frozen_seq = replay->last();
+  }
+  const ReplayRing::frame_t rf = replay->convert(frozen_seq);
+  if (scopes) {
+    scopes->analyze(rf.data, rf.stride, rf.xres, rf.yres, rf.field);
+  }
+  ui.draw(rf.data, rf.stride, rf.xres, rf.yres, rf.field);
+}
+
+void on_replay_key(MyUI &ui, xcb_key_press_event_t *ev)
+{
+  if (replay->empty()) {
+    return;
+  }
+  if (ev->detail == 0x41) { // space: freeze / resume live view       // FIXME?!
+    frozen = !frozen;
+    if (frozen) {
+      frozen_seq = replay->last();
+      show_replay(ui);  // (also: must not keep referencing the soon-to-be-freed ndi frame)
+    }
+  } else if (frozen && ev->detail == 0x71) { // left: one frame back
+    if (frozen_seq > replay->first()) {
+      frozen_seq--;
+    }
+    show_replay(ui);
+  } else if (frozen && ev->detail == 0x72) { // right: one frame forward
+    frozen_seq++;
+    show_replay(ui);
+  }
+}
+
 void do_list()
 {
-  NDIlib_find_instance_t finder = NDIlib_find_create_v2();
-  if (!finder) {
-    throw std::runtime_error("NDIlib_find_create_v2 failed");
+  SourceTableReader table;
+  source_list_t list;
+  if (table.open() && table.snapshot(list)) { // daemon is running: no need for an own finder
+    printf("Found %zu Sources:\n", list.size());
+    for (const auto &src : list) {
+      printf("  %s  %s\n", src.first.c_str(), src.second.c_str());
+    }
+    printf("\n");
+    return;
   }
 
-  sleep(1);
-  // NDIlib_find_wait_for_sources(pNDI_find, 1000/* One second */);
+  SourceFinder finder;
+
+  // instead of a fixed delay: done once the list did not change for a moment
+  finder.wait_settled(1000, 200, 2000);
 
   uint32_t no_sources = 0;
-  const NDIlib_source_t* p_sources = NULL;
-  p_sources = NDIlib_find_get_current_sources(finder, &no_sources);
+  const NDIlib_source_t* p_sources = finder.sources(no_sources);
 
   printf("Found %d Sources:\n", no_sources);
   for (uint32_t i = 0; i < no_sources; i++) {
     printf("  %s  %s\n", p_sources[i].p_ndi_name, p_sources[i].p_url_address);
   }
   printf("\n");
-  NDIlib_find_destroy(finder);
+
+  SourceCache cache;
+  if (cache.update(p_sources, no_sources)) {
+    cache.save();
+  }
+}
+
+volatile sig_atomic_t stop_requested = 0;
+
+void on_stop_signal(int)
+{
+  stop_requested = 1;
+}
+
+// single finder for all instances on this host, publishes the source table in shm (see srctable.h)
+// fake_table: publish contents of that file instead (name<TAB>url per line, reloaded when changed), for testing
+void do_daemon(const char *fake_table)
+{
+  SourceTableWriter table;
+  signal(SIGINT, on_stop_signal);
+  signal(SIGTERM, on_stop_signal);
+
+  if (fake_table) {
+    struct timespec mtime = {};
+    while (!stop_requested) {
+      struct stat st;
+      if (stat(fake_table, &st) == 0 &&
+          (st.st_mtim.tv_sec != mtime.tv_sec || st.st_mtim.tv_nsec != mtime.tv_nsec)) {
+        mtime = st.st_mtim;
+        const SourceCache fake{fake_table};
+        table.publish(fake.list());
+        if (opt_verbose) {
+          printf("Published %zu sources from %s.\n", fake.list().size(), fake_table);
+        }
+      }
+      usleep(200000);
+    }
+    return;
+  }
+
+  SourceFinder finder;
+  SourceCache cache;
+  while (!stop_requested) {
+    if (!finder.wait(1000)) {
+      continue;
+    }
+    uint32_t num;
+    const NDIlib_source_t *src = finder.sources(num);
+
+    source_list_t list;
+    for (uint32_t i = 0; i < num; i++) {
+      if (src[i].p_ndi_name) {
+        list.emplace_back(src[i].p_ndi_name, (src[i].p_url_address) ? src[i].p_url_address : "");
+      }
+    }
+    table.publish(list);
+    if (opt_verbose) {
+      printf("Published %zu sources.\n", list.size());
+    }
+
+    if (cache.update(src, num)) {
+      cache.save();
+    }
+  }
+}
+
+static void json_string(const std::string &str)
+{
+  putchar('"');
+  for (unsigned char ch : str) {
+    if (ch == '"' || ch == '\\') {
+      printf("\\%c", ch);
+    } else if (ch < 0x20) {
+      printf("\\u%04x", ch);
+    } else {
+      putchar(ch);
+    }
+  }
+  putchar('"');
+}
+
+static void watch_event(const char *event, const std::string &name, const std::string &url, const std::string *old_url = nullptr)
+{
+  printf("{\"event\":\"%s\",\"name\":", event);
+  json_string(name);
+  printf(",\"url\":");
+  json_string(url);
+  if (old_url) {
+    printf(",\"old_url\":");
+    json_string(*old_url);
+  }
+  printf("}\n");
+}
+
+// --watch: one JSON object per line for each source that appears, disappears or changes its url
+// (the initial list is reported as "appear")
+void do_watch()
+{
+  SourceFinder finder;
+  SourceCache cache;
+  signal(SIGINT, on_stop_signal);
+  signal(SIGTERM, on_stop_signal);
+  signal(SIGPIPE, SIG_IGN);  // -> EPIPE, see fflush() below
+
+  source_list_t known;
+  while (!stop_requested) {
+    if (!finder.wait(1000)) { // (blocks in the SDK; timeout only to check for signals)
+      continue;
+    }
+    uint32_t num;
+    const NDIlib_source_t *src = finder.sources(num);
+
+    source_list_t cur;
+    for (uint32_t i = 0; i < num; i++) {
+      if (src[i].p_ndi_name) {
+        cur.emplace_back(src[i].p_ndi_name, (src[i].p_url_address) ? src[i].p_url_address : "");
+      }
+    }
+
+    for (const auto &c : cur) {
+      auto it = std::find_if(known.begin(), known.end(), [&](const auto &k) { return k.first == c.first; });
+      if (it == known.end()) {
+        watch_event("appear", c.first, c.second);
+      } else if (it->second != c.second) {
+        watch_event("change", c.first, c.second, &it->second);
+      }
+    }
+    for (const auto &k : known) {
+      if (std::none_of(cur.begin(), cur.end(), [&](const auto &c) { return c.first == k.first; })) {
+        watch_event("disappear", k.first, k.second);
+      }
+    }
+    if (fflush(stdout) != 0) { // reader went away
+      break;
+    }
+    known.swap(cur);
+
+    if (cache.update(src, num)) {
+      cache.save();
+    }
+  }
+}
+
+void record_one(const NDIlib_video_frame_v2_t &vf)
+{
+  const rawfile_index_t idx = {
+    0, rawfile_frame_size(vf.FourCC, vf.xres, vf.yres, vf.line_stride_in_bytes),
+    (uint32_t)vf.FourCC, vf.xres, vf.yres, vf.line_stride_in_bytes,
+    vf.frame_rate_N, vf.frame_rate_D,
+    vf.frame_format_type, vf.picture_aspect_ratio,
+    vf.timecode, vf.timestamp
+  };
+  const uint64_t dropped = recorder->dropped();
+  if (!recorder->push(vf.p_data, idx)) {
+    if (dropped == 0) {
+      fprintf(stderr, "Recorder cannot keep up, dropping frames.\n");
+    } else if (opt_verbose) {
+      printf("Recorder dropped frame (%llu total).\n", (unsigned long long)dropped + 1);
+    }
+  }
+}
+
+void output_one(int vf)
+{
+  const NDIlib_video_frame_v2_t &f = video_frame[vf];
+  const uint64_t dropped = pipeout->dropped();
+  const PipeOutput::frame_t frame = {
+    f.p_data, f.line_stride_in_bytes, f.xres, f.yres,
+    (uint32_t)f.FourCC, f.frame_rate_N, f.frame_rate_D
+  };
+  vf_held[vf] = pipeout->push(frame, &video_frame[vf]);
+  if (opt_verbose && pipeout->dropped() != dropped) {
+    printf("Pipe output dropped frame (%llu total).\n", (unsigned long long)pipeout->dropped());
+  }
+}
+
+// with url, the SDK connects directly (no discovery); name can be NULL then
+NDIlib_recv_instance_t create_recv(const char *name, const char *url)
+{
+  NDIlib_recv_create_v3_t rcvt(
+    { name, url },
+    NDIlib_recv_color_format_best,  // (UYVY/UYVA, P216/PA16 for high bit depth: converted by YuvConverter; CAVE: linux: RGBX_RGBA is buggy)
+    NDIlib_recv_bandwidth_highest,
+    true  // allow_video_fields_: deinterlaced by MyUI (-d)
+  );
+
+  NDIlib_recv_instance_t ret = NDIlib_recv_create_v3(&rcvt);
+  if (!ret) {
+    throw std::runtime_error("NDIlib_recv_create_v3 failed");
+  }
+#if 0   // TODO? hw accel ?
+    NDIlib_metadata_frame_t meta;  // {0, NDIlib_send_timecode_synthesize, (char *)"..."};
+    meta.p_data = (char *)"<ndi_hwaccel enabled=\"true\"/>";
+    NDIlib_recv_send_metadata(ret, &meta);
+#endif
+
+  NDIlib_recv_set_tally(ret, &tally);
+  return ret;
+}
+
+void destroy_unused_recvs()
+{
+  for (size_t i = 0; i < retired_recvs.size(); ) {
+    bool used = false;
+    for (int vf = 0; vf < NUM_VF; vf++) {
+      used |= (vf_recv[vf] == retired_recvs[i]);
+    }
+    if (!used) {
+      NDIlib_recv_destroy(retired_recvs[i]);
+      retired_recvs.erase(retired_recvs.begin() + i);
+    } else {
+      i++;
+    }
+  }
+}
+
+void free_vf(int vf)
+{
+  // assert(vf_recv[vf] && !vf_held[vf]);
+  NDIlib_recv_free_video_v2(vf_recv[vf], &video_frame[vf]);
+  vf_recv[vf] = NULL;
+  if (!retired_recvs.empty()) {
+    destroy_unused_recvs();
+  }
+}
+
+int unused_vf()
+{
+  int vf = 0;
+  while (vf_recv[vf]) {
+    vf++;
+  }
+  // assert(vf < NUM_VF);
+  return vf;
+}
+
+void release_held()
+{
+  pipeout->collect([](void *token) {
+    const int vf = (NDIlib_video_frame_v2_t *)token - video_frame;
+    vf_held[vf] = false;
+    if (vf != cur_vf) {
+      free_vf(vf);
+    }
+  });
+}
+
+field_t field_of(int frame_format_type)
+{
+  switch (frame_format_type) {
+  case NDIlib_frame_format_type_interleaved: return FIELD_INTERLEAVED;
+  case NDIlib_frame_format_type_field_0: return FIELD_0;
+  case NDIlib_frame_format_type_field_1: return FIELD_1;
+  default: return FIELD_NONE;
+  }
 }
 
 #define UN_FOURCC(v)  (char)(v&0xff), (char)((v>>8)&0xff), (char)((v>>16)&0xff), (char)((v>>24)&0xff)
 
-void recv_one(NDIlib_recv_instance_t recv, MyUI &ui, int timeout_ms = 100)
+// full-frame BGRA, also for replay / scopes
+static void draw_converted(const NDIlib_video_frame_v2_t &vf, field_t field, int64_t timestamp, MyUI &ui)
 {
-  const int next_vf = (cur_vf & 1) ^ 1;
+  const YuvConverter::view_t img = yuv.convert(vf.p_data, vf.line_stride_in_bytes, vf.FourCC, vf.xres, vf.yres);
+  if (!img.data) {
+    static bool warned = false;
+    if (!warned) {
+      fprintf(stderr, "Unsupported FourCC %c%c%c%c received.\n", UN_FOURCC(vf.FourCC));
+      warned = true;
+    }
+    return;
+  }
+  if (opt_verbose && img.data != vf.p_data) {
+    printf("  Color matrix: %s\n", colorspace_name(yuv.colorspace()));
+  }
 
-//  printf("recv connections: %d\n", NDIlib_recv_get_no_connections(recv));
+  if (replay) {
+    replay->push(img.data, img.stride, vf.xres, vf.yres, field,
+                 vf.frame_rate_N, vf.frame_rate_D);
+    if (frozen) {
+      return;  // (keep recording, but do not show)
+    }
+  }
 
-  switch (NDIlib_recv_capture_v2(recv, &video_frame[next_vf], nullptr, nullptr, timeout_ms)) {
-  case NDIlib_frame_type_none:   // No data
-    // (don't spam console, even with opt_verbose...)
-    break;
+  if (scopes) {
+    scopes->analyze(img.data, img.stride, vf.xres, vf.yres, field);
+  }
 
-  case NDIlib_frame_type_video:  // Video data
-    if (cur_vf >= 0) {
-      NDIlib_recv_free_video_v2(recv, &video_frame[cur_vf]);
+  ui.draw(img.data, img.stride, vf.xres, vf.yres, field,
+          timestamp, vf.frame_rate_N, vf.frame_rate_D, img.alpha);
+}
+
+void show_video(int next_vf, MyUI &ui)
+{
+  if (cur_vf >= 0 && !vf_held[cur_vf]) {
+    free_vf(cur_vf);
+  }
+  cur_vf = next_vf;
+  if (stats.frames++ == 0) {
+    startup_phase("first frame");
+  }
+
+  const NDIlib_video_frame_v2_t &vf = video_frame[cur_vf];
+  if (opt_verbose) {
+    printf("Video data received (%dx%d).\n", vf.xres, vf.yres);
+    printf("  FourCC: %c%c%c%c, PAR: %f, ffmt: %02x, fps: %d/%d, timecode: %lld\n",
+           UN_FOURCC(vf.FourCC),
+           vf.picture_aspect_ratio,
+           vf.frame_format_type,
+           vf.frame_rate_N, vf.frame_rate_D,
+           vf.timecode);    // FIXME: iphone returns timecode (and Sienna NDI Monitor shows it, but we get only 0(?!))  [ --> BUG in linux sdk !? - it works on mac os !]
+  }
+
+  // TODO? check FourCC (+ alpha!!), picture_aspect_ratio (= xres/yres [send: 0.0f]?), fps, timecode, stride, metadata, timestamp] ?
+
+  if (recorder) {
+    record_one(vf);
+  }
+
+  if (pipeout) {
+    output_one(cur_vf);
+  }
+
+  const int64_t timestamp = (vf.timestamp != NDIlib_recv_timestamp_undefined) ? vf.timestamp : 0;
+  const field_t field = field_of(vf.frame_format_type);
+  if (!replay && !scopes && field == FIELD_NONE && yuv.prepare_rows(vf.FourCC, vf.xres, vf.yres)) { // (nothing else needs BGRA)
+    if (opt_verbose) {
+      printf("  Color matrix: %s\n", colorspace_name(yuv.colorspace()));
     }
-    cur_vf = next_vf;
+    ui.draw_yuv(yuv, vf.p_data, vf.line_stride_in_bytes, vf.FourCC, vf.xres, vf.yres,
+                timestamp, vf.frame_rate_N, vf.frame_rate_D);
+  } else {
+    draw_converted(vf, field, timestamp, ui);
+  }
+}
+
+// cut over as soon as the new source has a frame ready; old source stays on screen meanwhile
+void poll_pending(MyUI &ui)
+{
+  const int vf = unused_vf();
+  switch (NDIlib_recv_capture_v2(pending_recv, &video_frame[vf], nullptr, nullptr, 0)) {
+  case NDIlib_frame_type_video:
+    vf_recv[vf] = pending_recv;
+
+    retired_recvs.push_back(recv);
+    recv = pending_recv;
+    recv_name.swap(pending_name);
+    pending_recv = NULL;
+    pending_name.clear();
+    stats.switches++;
+
+    ui.set_title(recv_name.c_str());
+    show_video(vf, ui);
+    destroy_unused_recvs();  // (old frame might have been the last one)
 
     if (opt_verbose) {
-      printf("Video data received (%dx%d).\n", video_frame[cur_vf].xres, video_frame[cur_vf].yres);
-      printf("  FourCC: %c%c%c%c, PAR: %f, ffmt: %02x, fps: %d/%d, timecode: %lld\n",
-             UN_FOURCC(video_frame[cur_vf].FourCC),
-             video_frame[cur_vf].picture_aspect_ratio,
-             video_frame[cur_vf].frame_format_type,
-             video_frame[cur_vf].frame_rate_N, video_frame[cur_vf].frame_rate_D,
-             video_frame[cur_vf].timecode);    // FIXME: iphone returns timecode (and Sienna NDI Monitor shows it, but we get only 0(?!))  [ --> BUG in linux sdk !? - it works on mac os !]
+      printf("Switched to %s.\n", recv_name.c_str());
     }
+    break;
 
-    // TODO? check FourCC (+ alpha!!), picture_aspect_ratio (= xres/yres [send: 0.0f]?), frame format=progressive [not interlaced!], fps, timecode, stride, metadata, timestamp] ?
+  case NDIlib_frame_type_error:
+    fprintf(stderr, "Error received from %s.\n", pending_name.c_str());
+    break;
 
-    ui.draw(video_frame[cur_vf].p_data, video_frame[cur_vf].line_stride_in_bytes, video_frame[cur_vf].xres, video_frame[cur_vf].yres);
+  default:
+    break;
+  }
+}
+
+void recv_one(MyUI &ui, int timeout_ms = 100)
+{
+  if (pipeout) {
+    release_held();
+  }
+
+  if (pending_recv) {
+    poll_pending(ui);
+    timeout_ms = std::min(timeout_ms, 5);  // (do not miss the pending source's first frame by much)
+  }
+
+  const int next_vf = unused_vf();
+  NDIlib_audio_frame_v2_t audio_frame;
+
+//  printf("recv connections: %d\n", NDIlib_recv_get_no_connections(recv));
+
+  // (without audio frame, the SDK does not deliver audio at all)
+  switch (NDIlib_recv_capture_v2(recv, &video_frame[next_vf], (audio || meters) ? &audio_frame : nullptr, nullptr, timeout_ms)) {
+  case NDIlib_frame_type_none:   // No data
+    // (don't spam console, even with opt_verbose...)
+    break;
+
+  case NDIlib_frame_type_video:  // Video data
+    vf_recv[next_vf] = recv;
+    show_video(next_vf, ui);
     break;
 
   case NDIlib_frame_type_audio:  // Audio data
-    if (opt_verbose) {
-      printf("Audio data received ?!?.\n");
-//      printf("Audio data received (%d samples).\n", audio_frame.no_samples);
+    if (meters) {
+      meters->update(audio_frame.p_data, audio_frame.channel_stride_in_bytes, audio_frame.no_channels, audio_frame.no_samples,
+                     audio_frame.sample_rate);
+    }
+    if (audio) {
+      audio->push(audio_frame.p_data, audio_frame.channel_stride_in_bytes, audio_frame.no_channels, audio_frame.no_samples,
+                  audio_frame.sample_rate, (audio_frame.timestamp != NDIlib_recv_timestamp_undefined) ? audio_frame.timestamp : 0);
     }
-//    NDIlib_recv_free_audio_v2(recv, &audio_frame);
+    NDIlib_recv_free_audio_v2(recv, &audio_frame);
     break;
 
   case NDIlib_frame_type_metadata:  // should not happen (nullptr ...);
@@ -94,6 +560,317 @@ void recv_one(NDIlib_recv_instance_t recv, MyUI &ui, int timeout_ms = 100)
   }
 }
 
+std::string stats_line(const MyUI &ui)
+{
+  char buf[512];
+  int len = snprintf(buf, sizeof(buf), "frames=%llu switches=%llu",
+                     (unsigned long long)stats.frames, (unsigned long long)stats.switches);
+
+  NDIlib_recv_performance_t total = {}, dropped = {};
+  NDIlib_recv_get_performance(recv, &total, &dropped);
+  len += snprintf(buf + len, sizeof(buf) - len, " ndi_video=%lld ndi_dropped=%lld",
+                  (long long)total.video_frames, (long long)dropped.video_frames);
+
+  if (recorder) {
+    len += snprintf(buf + len, sizeof(buf) - len, " recorded=%llu record_dropped=%llu",
+                    (unsigned long long)recorder->frames(), (unsigned long long)recorder->dropped());
+  }
+  if (pipeout) {
+    len += snprintf(buf + len, sizeof(buf) - len, " output=%llu output_dropped=%llu",
+                    (unsigned long long)pipeout->frames(), (unsigned long long)pipeout->dropped());
+  }
+  if (workers) {
+    const WorkerPool::stats_t ws = workers->stats();
+    len += snprintf(buf + len, sizeof(buf) - len, " pool_threads=%u pool_runs=%llu pool_tasks=%llu pool_steals=%llu task_avg_us=%.1f task_max_us=%.1f",
+                    workers->size(), (unsigned long long)ws.runs, (unsigned long long)ws.tasks, (unsigned long long)ws.steals,
+                    ws.tasks ? ws.task_ns / 1e3 / ws.tasks : 0.0, ws.task_ns_max / 1e3);
+  }
+  const MyUI::alpha_stats_t &astats = ui.alpha_stats();
+  len += snprintf(buf + len, sizeof(buf) - len, " alpha_opaque=%llu alpha_blended=%llu",
+                  (unsigned long long)astats.opaque, (unsigned long long)astats.blended);
+  return buf;
+}
+
+// shown as soon as it delivers (see poll_pending)
+void switch_source(const char *name, const char *url)
+{
+  if (pending_recv) { // superseded
+    NDIlib_recv_destroy(pending_recv);
+    pending_recv = NULL;
+  }
+  pending_recv = create_recv(name, url);
+  pending_name = (name) ? name : url;
+}
+
+// arg: "on", "off" or "" / "toggle"
+static bool parse_onoff(const std::string &arg, bool cur, bool &ok)
+{
+  ok = true;
+  if (arg == "on" || arg == "1") {
+    return true;
+  } else if (arg == "off" || arg == "0") {
+    return false;
+  } else if (arg.empty() || arg == "toggle") {
+    return !cur;
+  }
+  ok = false;
+  return cur;
+}
+
+void control_cmd(MyUI &ui, const std::string &line, std::string &reply)
+{
+  const size_t sep = line.find(' ');
+  const std::string cmd = line.substr(0, sep);
+  const std::string arg = (sep != std::string::npos) ? line.substr(sep + 1) : std::string();
+  bool ok = true;
+
+  if (cmd == "source" || cmd == "source-ip") {
+    if (arg.empty()) {
+      reply = "error missing source";
+      return;
+    }
+    try {
+      if (cmd == "source-ip") {
+        switch_source(NULL, arg.c_str());
+      } else {
+        switch_source(arg.c_str(), NULL);
+      }
+    } catch (std::exception &ex) {
+      reply = std::string("error ") + ex.what();
+      return;
+    }
+    reply = "ok switching";
+
+  } else if (cmd == "fullscreen") {
+    const bool val = parse_onoff(arg, ui.is_fullscreen(), ok);
+    if (ok) {
+      ui.fullscreen(val);
+    }
+  } else if (cmd == "transparency") {
+    const bool val = parse_onoff(arg, ui.is_transparent(), ok);
+    if (ok) {
+      ui.show_transparency(val);
+    }
+  } else if (cmd == "tally") {
+    if (arg == "none") {
+      tally = {false, false};
+    } else if (arg == "preview") {
+      tally = {false, true};
+    } else if (arg == "program") {
+      tally = {true, false};
+    } else if (arg == "both") {
+      tally = {true, true};
+    } else {
+      ok = false;
+    }
+    if (ok) {
+      NDIlib_recv_set_tally(recv, &tally);
+      if (pending_recv) {
+        NDIlib_recv_set_tally(pending_recv, &tally);
+      }
+    }
+  } else if (cmd == "stats") {
+    reply = "ok source=" + recv_name + " " + stats_line(ui);
+    if (pending_recv) {
+      reply += " pending=" + pending_name;
+    }
+    return;
+  } else if (cmd == "quit") {
+    quit = true;
+  } else {
+    reply = "error unknown command";
+    return;
+  }
+
+  reply = (ok) ? "ok" : "error bad argument";
+}
+
+// connect by cached address, if any; discovery checks the entry in the background
+void connect_by_name(const char *name)
+{
+  source_cache.reset(new SourceCache());
+  cached_name = name;
+
+  srctable.reset(new SourceTableReader());
+  if (!srctable->open()) {
+    srctable.reset();
+  } else {
+    const std::string url = srctable->lookup(name);
+    if (!url.empty()) { // current entry from the daemon: nothing to validate
+      if (opt_verbose) {
+        printf("Connecting to %s (from discovery daemon).\n", url.c_str());
+      }
+      recv = create_recv(name, url.c_str());
+      srctable.reset();
+      return;
+    }
+  }
+
+  cached_url = source_cache->lookup(name);
+  recv = create_recv(name, cached_url.empty() ? NULL : cached_url.c_str());
+  cached_deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+
+  if (opt_verbose && !cached_url.empty()) {
+    printf("Connecting to cached address %s.\n", cached_url.c_str());
+  }
+
+  if (srctable) {
+    return;
+  }
+  try {
+    finder.reset(new SourceFinder());
+  } catch (std::exception &ex) { // (only the cache is not maintained then)
+    fprintf(stderr, "Discovery not available: %s\n", ex.what());
+  }
+}
+
+void poll_discovery()
+{
+  std::string url;
+  if (srctable) {
+    if (srctable->changed()) {
+      url = srctable->lookup(cached_name);
+    }
+  } else if (finder && finder->wait(0)) {
+    uint32_t num;
+    const NDIlib_source_t *src = finder->sources(num);
+    if (source_cache->update(src, num)) {
+      source_cache->save();
+    }
+    url = finder->url_of(cached_name);
+  }
+
+  if (!url.empty()) {
+    if (!cached_url.empty() && url != cached_url && recv_name == cached_name && !pending_recv) {  // address changed
+      if (opt_verbose) {
+        printf("Cached address %s is stale, now %s.\n", cached_url.c_str(), url.c_str());
+      }
+      switch_source(cached_name.c_str(), url.c_str());
+    }
+    cached_url.clear();
+    finder.reset();  // source is known (and cached): no need for further discovery traffic
+    srctable.reset();
+    return;
+  }
+
+  if (!cached_url.empty() && stats.frames == 0 && !pending_recv &&
+      std::chrono::steady_clock::now() > cached_deadline) {  // nothing via cached address, not found by discovery yet either
+    if (opt_verbose) {
+      printf("No frames from cached address %s, looking up by name.\n", cached_url.c_str());
+    }
+    if (source_cache->forget(cached_name)) {
+      source_cache->save();
+    }
+    switch_source(cached_name.c_str(), NULL);
+    cached_url.clear();
+  }
+}
+
+void show_raw(MyUI &ui, const rawfile_index_t &idx, const uint8_t *data)
+{
+  const field_t field = field_of(idx.frame_format_type);
+  if (field == FIELD_NONE && yuv.prepare_rows(idx.fourcc, idx.xres, idx.yres)) { // (file stays mapped)
+    ui.draw_yuv(yuv, data, idx.stride, idx.fourcc, idx.xres, idx.yres);
+    return;
+  }
+
+  const YuvConverter::view_t img = yuv.convert(data, idx.stride, idx.fourcc, idx.xres, idx.yres);
+  if (!img.data) {
+    static bool warned = false;
+    if (!warned) {
+      fprintf(stderr, "Unsupported FourCC %c%c%c%c in file.\n", UN_FOURCC(idx.fourcc));
+      warned = true;
+    }
+    return;
+  }
+  ui.draw(img.data, img.stride, idx.xres, idx.yres, field, 0, 0, 0, img.alpha);
+}
+
+// speed: multiple of native frame rate, 0: as fast as possible (benchmark: quits at end)
+void do_play(MyUI &ui, RawPlayer &player, double speed)
+{
+  using clock = std::chrono::steady_clock;
+
+  if (!player.size()) {
+    fprintf(stderr, "No frames in file.\n");
+    return;
+  }
+
+  size_t pos = 0, cur = 0;  // next to show, last shown
+  bool paused = false, dirty = true;
+  clock::time_point next = clock::now();
+
+  auto seek = [&](size_t to) {
+    pos = std::min(to, player.size() - 1);
+    dirty = true;
+    next = clock::now();
+  };
+  auto seconds = [&](size_t at) -> size_t {
+    const rawfile_index_t &idx = player.index(at);
+    return (idx.frame_rate_N > 0 && idx.frame_rate_D > 0) ? idx.frame_rate_N / idx.frame_rate_D : 60;
+  };
+  ui.on_key_press([&](xcb_key_press_event_t *ev) {    // FIXME?! keycodes
+    switch (ev->detail) {
+    case 0x41: // space
+      paused = !paused;
+      if (!paused) {
+        seek(cur + 1);
+      }
+      break;
+    case 0x71: seek(cur ? cur - 1 : 0); break;  // left
+    case 0x72: seek(cur + 1); break;  // right
+    case 0x70: seek(cur > 10 * seconds(cur) ? cur - 10 * seconds(cur) : 0); break;  // page up: -10 s
+    case 0x75: seek(cur + 10 * seconds(cur)); break;  // page down: +10 s
+    case 0x6e: seek(0); break;  // home
+    case 0x73: seek(player.size() - 1); break;  // end
+    }
+  });
+
+  size_t shown = 0;
+  const clock::time_point start = clock::now();
+  while (ui.run_once()) {
+    if (paused && !dirty) {
+      ui.wait(-1);
+      continue;
+    }
+
+    const clock::time_point now = clock::now();
+    if (!dirty && now < next) {
+      ui.wait(std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count());
+      continue;
+    }
+
+    const rawfile_index_t &idx = player.index(pos);
+    show_raw(ui, idx, player.data(pos));
+    cur = pos;
+    dirty = false;
+    shown++;
+
+    if (speed > 0 && idx.frame_rate_N > 0 && idx.frame_rate_D > 0) {
+      next += std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(idx.frame_rate_D / (idx.frame_rate_N * speed)));
+      if (next < now) { // too slow: do not try to catch up
+        next = now;
+      }
+    } else {
+      next = now;
+    }
+
+    if (pos + 1 < player.size()) {
+      pos++;
+    } else if (speed == 0) {
+      ui.run_once();  // (render the last frame, before it is counted)
+      break;
+    } else {
+      paused = true;
+    }
+  }
+
+  if (opt_verbose || speed == 0) {
+    const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    printf("Shown %zu frames in %.3f s (%.1f fps).\n", shown, elapsed, shown / elapsed);
+  }
+}
+
 int main(int argc, char **argv)
 {
   // Not required, but "correct"
@@ -101,22 +878,58 @@ int main(int argc, char **argv)
     fprintf(stderr, "Cannot run NDI.");
     return 1;
   }
+  const std::chrono::steady_clock::time_point ndi_ready = std::chrono::steady_clock::now();
 
   // -- Argument processing --
 
   bool opt_usage = false,
        opt_list = false,
+       opt_watch = false,
+       opt_daemon = false,
        opt_tally_pvw = false, opt_tally_pgm = false,
        opt_gray = false,
        opt_fullscreen = false,
        opt_ipsrc = false,
-       opt_transparency = false;
+       opt_transparency = false,
+       opt_argb = false,
+       opt_meters = false,
+       opt_scopes = false;
   const char *opt_src = NULL;
+  int opt_replay = 0;
+  const char *opt_record = NULL;
+  const char *opt_play = NULL;
+  const char *opt_output = NULL;
+  bool opt_y4m = false, opt_native = false;
+  const char *opt_control = NULL;
+  const char *opt_fake_table = NULL;
+  Deinterlace opt_deinterlace = Deinterlace::ADAPTIVE;
+  double opt_refresh = 0;
+  const char *opt_audio = NULL;
+  const char *opt_lut = NULL;
+  colorspace_t opt_colorspace;
+  bool opt_dither = true;
+  bool opt_pin = false;
+  double opt_speed = 1.0;
+
+  enum { OPT_WATCH = 0x100, OPT_NO_DITHER, OPT_PIN_THREADS, OPT_NATIVE };
+  static const struct option long_opts[] = {
+    {"watch", no_argument, NULL, OPT_WATCH},
+    {"no-dither", no_argument, NULL, OPT_NO_DITHER},
+    {"pin-threads", no_argument, NULL, OPT_PIN_THREADS},
+    {"native", no_argument, NULL, OPT_NATIVE},
+    {}
+  };
 
   int opt;
-  while ((opt = getopt(argc, argv, "lhpmvgfit")) != -1) {
+  while ((opt = getopt_long(argc, argv, "lhDF:pmvgfitTMSd:R:L:C:a:r:w:o:yc:P:x:", long_opts, NULL)) != -1) {
     switch (opt) {
     case 'l': opt_list = true; break;
+    case OPT_WATCH: opt_watch = true; break;
+    case OPT_NO_DITHER: opt_dither = false; break;
+    case OPT_PIN_THREADS: opt_pin = true; break;
+    case OPT_NATIVE: opt_native = true; break;
+    case 'D': opt_daemon = true; break;
+    case 'F': opt_fake_table = optarg; break;
     case 'p': opt_tally_pvw = true; break;
     case 'm': opt_tally_pgm = true; break;
     case 'v': opt_verbose = true; break;
@@ -124,6 +937,49 @@ int main(int argc, char **argv)
     case 'f': opt_fullscreen = true; break;
     case 'i': opt_ipsrc = true; break;
     case 't': opt_transparency = true; break;
+    case 'T': opt_transparency = opt_argb = true; break;
+    case 'M': opt_meters = true; break;
+    case 'S': opt_scopes = true; break;
+    case 'L': opt_lut = optarg; break;
+    case 'C':
+      if (!parse_colorspace(optarg, opt_colorspace)) {
+        fprintf(stderr, "Bad color matrix: %s\n", optarg);
+        opt_usage = true;
+      }
+      break;
+    case 'd':
+      if (!parse_deinterlace(optarg, opt_deinterlace)) {
+        fprintf(stderr, "Bad deinterlace mode: %s\n", optarg);
+        opt_usage = true;
+      }
+      break;
+    case 'R':
+      opt_refresh = atof(optarg);
+      if (opt_refresh <= 0) {
+        fprintf(stderr, "Bad refresh rate: %s\n", optarg);
+        opt_usage = true;
+      }
+      break;
+    case 'r':
+      opt_replay = atoi(optarg);
+      if (opt_replay <= 0) {
+        fprintf(stderr, "Bad replay length: %s\n", optarg);
+        opt_usage = true;
+      }
+      break;
+    case 'a': opt_audio = optarg; break;
+    case 'w': opt_record = optarg; break;
+    case 'o': opt_output = optarg; break;
+    case 'y': opt_y4m = true; break;
+    case 'c': opt_control = optarg; break;
+    case 'P': opt_play = optarg; break;
+    case 'x':
+      opt_speed = atof(optarg);
+      if (opt_speed < 0) {
+        fprintf(stderr, "Bad speed: %s\n", optarg);
+        opt_usage = true;
+      }
+      break;
     default:
       fprintf(stderr, "Bad argument: %c\n", opt);
     case 'h':
@@ -132,7 +988,13 @@ int main(int argc, char **argv)
     }
   }
 
-  if (!opt_list) {
+  if (opt_fake_table && !opt_daemon) {
+    opt_usage = true;
+  } else if (opt_play || opt_daemon || opt_watch) {
+    if (optind != argc) {
+      opt_usage = true;
+    }
+  } else if (!opt_list) {
     if (optind + 1 == argc) {
       opt_src = argv[optind];
     } else {
@@ -141,27 +1003,124 @@ int main(int argc, char **argv)
   }
 
   if (opt_usage) {
-    fprintf(stderr, "Usage: %s [-l | -h | [-pmvgfity] ndi_source]\n"
+    fprintf(stderr, "Usage: %s [-l | --watch | -h | -D [-F file] [-v] | -P file [-x speed] [-vgftT] [-d mode] [-L lut] [-C matrix] [--no-dither] [--pin-threads] | [-pmvgfitTMS] [-d mode] [-R hz] [-L lut] [-C matrix] [--no-dither] [--pin-threads] [-a out] [-r secs] [-w file] [-o file [-y | --native]] [-c socket] ndi_source]\n"
                     "  -l  List available sources\n"
-                    "  -h  Help\n\n"
+                    "  --watch  Keep watching, print changed sources as JSON lines (appear, disappear, change)\n"
+                    "  -h  Help\n"
+                    "  -D  Run as discovery daemon, shared by all instances of this user\n"
+                    "  -F  Daemon publishes sources from file (name<TAB>url per line) instead, for testing\n"
+                    "  -P  Play back recorded file (space: pause, left/right: step, pgup/pgdn: -/+10s)\n"
+                    "  -x  Playback speed as multiple of native fps, 0: as fast as possible (default: 1)\n\n"
                     "  -p  Send Preview Tally\n"
                     "  -m  Send Program Tally\n"
-                    "  -v  Verbose\n"
+                    "  -v  Verbose (incl. startup timings)\n"
                     "  -g  Gray letterbox background\n"
                     "  -f  Fullscreen\n"
                     "  -i  Treat ndi_source as ip:port instead of ndi name\n"
-                    "  -t  Show transparency\n",
+                    "  -t  Show transparency\n"
+                    "  -T  Show transparency through to the desktop (ARGB window, needs a compositing manager)\n"
+                    "  -d  Deinterlace: weave, bob, adaptive (default)\n"
+                    "  -R  Present at display refresh rate hz (frame-rate conversion: repeat, drop or blend frames)\n"
+                    "  -L  Apply display LUT from .cube file (3D, with optional 1D shaper, or 1D)\n"
+                    "  -C  Color matrix of YUV sources: auto (default: by resolution), bt601, bt709, bt2020; :full for full range\n"
+                    "  --no-dither  Round 16 bit sources (P216/PA16) to 8 bit instead of ordered dithering\n"
+                    "  --pin-threads  Pin the image processing threads to one cpu each\n"
+                    "  -M  Show audio level meters\n"
+                    "  -S  Show video scopes (s: waveform, rgb parade, vectorscope, histogram, off)\n"
+                    "  -a  Play audio, lip-synced: alsa, alsa:device, or file (.wav)\n"
+                    "  -r  Keep last secs for instant replay (space: freeze, left/right: step)\n"
+                    "  -w  Record received frames (untouched) to file\n"
+                    "  -o  Output raw frames to file/fifo, - for stdout (BGRX, or BGRA for sources with alpha; rows packed, no header)\n"
+                    "  -y  Output as Y4M (4:2:2) instead of raw\n"
+                    "  --native  Output raw frames in the FourCC of the source instead (UYVY, UYVA, P216, PA16, BGRX or BGRA; not converted)\n"
+                    "  -c  Listen for control commands on unix socket (source, source-ip, fullscreen, transparency, tally, stats, quit)\n",
                     argv[0]);
     return 1;
   }
 
   // --
 
+  yuv.set_colorspace(opt_colorspace);
+  yuv.set_dither(opt_dither);
+
   if (opt_list) {
     do_list();
 
+  } else if (opt_watch) {
+    do_watch();
+
+  } else if (opt_daemon) {
+    do_daemon(opt_fake_table);
+
+  } else if (opt_play) {
+    RawPlayer player{opt_play};
+    MyUI ui{opt_play, opt_gray, opt_argb};
+    if (opt_argb && !ui.is_argb()) {
+      fprintf(stderr, "No ARGB visual, showing transparency on a checkerboard.\n");
+    }
+
+    workers.reset(new WorkerPool(std::max(std::thread::hardware_concurrency(), 1u) - 1, opt_pin));
+    ui.set_workers(workers.get());
+
+    if (opt_lut) {
+      ui.set_lut(std::unique_ptr<Lut3d>(new Lut3d(opt_lut)));
+    }
+
+    if (opt_fullscreen) {
+      ui.fullscreen(opt_fullscreen);
+    }
+
+    if (opt_transparency) {
+      ui.show_transparency(opt_transparency);
+    }
+    ui.set_deinterlace(opt_deinterlace);
+
+    do_play(ui, player, opt_speed);
+    ui.close();
+
   } else {
-    MyUI ui{opt_src, opt_gray};
+    startup_phase("NDI initialized", ndi_ready);
+
+    // the receiver connects in the background (SDK threads), i.e. in parallel with the remaining setup
+    tally = {opt_tally_pgm, opt_tally_pvw};
+    if (opt_ipsrc) {
+      recv = create_recv(NULL, opt_src);
+    } else {
+      connect_by_name(opt_src);
+    }
+    recv_name = opt_src;
+    startup_phase("receiver created");
+
+    if (opt_audio) {
+      audio.reset(new AudioOutput(create_audio_sink(opt_audio)));
+    }
+
+    if (opt_record) {
+      recorder.reset(new Recorder(opt_record));
+    }
+
+    if (opt_output) {
+      int fd;
+      if (strcmp(opt_output, "-") == 0) {
+        fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);  // keep (verbose) messages out of the stream
+      } else {
+        fd = open(opt_output, O_WRONLY | O_CREAT | O_TRUNC, 0644);  // (fifo: blocks until reader is there)
+      }
+      if (fd == -1) {
+        perror("Could not open output");
+        return 1;
+      }
+      signal(SIGPIPE, SIG_IGN);  // -> EPIPE
+      pipeout.reset(new PipeOutput(fd, opt_y4m ? PipeOutput::Y4M : opt_native ? PipeOutput::NATIVE : PipeOutput::RAW));
+      pipeout->set_conversion(opt_colorspace, opt_dither);
+    }
+
+    MyUI ui{opt_src, opt_gray, opt_argb};
+    if (opt_argb && !ui.is_argb()) {
+      fprintf(stderr, "No ARGB visual, showing transparency on a checkerboard.\n");
+    }
+    startup_phase("window ready");
 
     if (opt_fullscreen) {
       ui.fullscreen(opt_fullscreen);
@@ -170,39 +1129,117 @@ int main(int argc, char **argv)
     if (opt_transparency) {
       ui.show_transparency(opt_transparency);
     }
+    ui.set_deinterlace(opt_deinterlace);
 
-    NDIlib_recv_create_v3_t rcvt(
-      { (opt_ipsrc ? NULL : opt_src), (opt_ipsrc ? opt_src : NULL) },
-      NDIlib_recv_color_format_BGRX_BGRA  // (CAVE: linux: RGBX_RGBA is buggy)
-//      , NDIlib_recv_bandwidth_highest
-//      , false // allow_video_fields_
-    );
+    if (opt_refresh > 0) {
+      ui.set_refresh(opt_refresh);
+    }
 
-    NDIlib_recv_instance_t recv = NDIlib_recv_create_v3(&rcvt);
-    if (!recv) {
-      throw std::runtime_error("NDIlib_recv_create_v3 failed");
+    workers.reset(new WorkerPool(std::max(std::thread::hardware_concurrency(), 1u) - 1, opt_pin));  // (render strips, LUT, scopes)
+    ui.set_workers(workers.get());
+
+    if (opt_lut) {
+      ui.set_lut(std::unique_ptr<Lut3d>(new Lut3d(opt_lut)));
+    }
+
+    if (opt_meters) { // (updated with the next video frame)
+      meters.reset(new AudioMeters);
+    }
+
+    if (opt_scopes) {
+      scopes.reset(new Scopes(*workers));
+      scopes->set_mode(ScopeMode::WAVEFORM);
+      ui.on_key_press([&ui](xcb_key_press_event_t *ev) {
+        if (ev->detail == 0x27) { // s      // FIXME?!
+          scopes->next_mode();
+          if (frozen) {
+            show_replay(ui);  // (otherwise: with the next frame)
+          }
+        }
+      });
     }
-#if 0   // TODO? hw accel ?
-      NDIlib_metadata_frame_t meta;  // {0, NDIlib_send_timecode_synthesize, (char *)"..."};
-      meta.p_data = (char *)"<ndi_hwaccel enabled=\"true\"/>";
-      NDIlib_recv_send_metadata(recv, &meta);
-#endif
 
-    const NDIlib_tally_t tally{opt_tally_pgm, opt_tally_pvw};
-    NDIlib_recv_set_tally(recv, &tally);
+    if (audio) { // (lip sync to what is actually on screen)
+      ui.on_present([](int64_t timestamp) {
+        audio->video_shown(timestamp);
+      });
+    }
+
+    if (meters || scopes) {
+      ui.set_overlay([](uint8_t *bgrx, int stride, int width, int height, int y0, int rows) {
+        if (scopes) {
+          scopes->draw(bgrx, stride, width, height, y0, rows);
+        }
+        if (meters) {
+          meters->draw(bgrx, stride, width, height, y0, rows);
+        }
+      });
+    }
+
+    if (opt_replay) {
+      replay.reset(new ReplayRing(opt_replay));
+      ui.on_key_press([&ui](xcb_key_press_event_t *ev) {
+        on_replay_key(ui, ev);
+      });
+    }
 
-    while (ui.run_once()) {
-      recv_one(recv, ui);
+    std::unique_ptr<ControlSocket> control;
+    if (opt_control) {
+      control.reset(new ControlSocket(opt_control, [&ui](const std::string &cmd, std::string &reply) {
+        control_cmd(ui, cmd, reply);
+      }));
+    }
+
+    while (!quit && ui.run_once()) {
+      if (control) {
+        control->poll();
+      }
+      poll_discovery();
+      recv_one(ui, ui.until_tick(100));
     }
 
     // close ui as soon as possible for more responsive feel
     ui.close();
 
+    if (pipeout) {
+      pipeout->close();
+      release_held();
+      if (opt_verbose || pipeout->failed()) {
+        fprintf(stderr, "Output %llu frames, %llu dropped%s.\n",
+                (unsigned long long)pipeout->frames(), (unsigned long long)pipeout->dropped(),
+                pipeout->failed() ? " (write error)" : "");
+      }
+      pipeout.reset();
+    }
+
     if (cur_vf >= 0) {
-      NDIlib_recv_free_video_v2(recv, &video_frame[cur_vf]);
+      free_vf(cur_vf);
       cur_vf = -1;
     }
+    // assert(!vf_recv[...]);
+    destroy_unused_recvs();
+    if (pending_recv) {
+      NDIlib_recv_destroy(pending_recv);
+    }
     NDIlib_recv_destroy(recv);
+
+    if (recorder) {
+      recorder->close();  // (waits for writer)
+      if (opt_verbose || recorder->dropped() || recorder->failed()) {
+        printf("Recorded %llu frames, %llu dropped%s.\n",
+               (unsigned long long)recorder->frames(), (unsigned long long)recorder->dropped(),
+               recorder->failed() ? " (write error)" : "");
+      }
+      recorder.reset();
+    }
+
+    if (audio) {
+      if (opt_verbose) {
+        printf("Audio: %llu samples dropped, %llu inserted (sync).\n",
+               (unsigned long long)audio->dropped(), (unsigned long long)audio->inserted());
+      }
+      audio.reset();  // (finishes file)
+    }
   }
 
   // --
@@ -0,0 +1,186 @@
+#include "meters.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#define PEAK_FALL   20.0f   // dB/s
+#define RMS_TAU     0.3f    // s
+#define METER_RANGE 60.0f   // dB
+
+static void block_levels_C(const float *data, int samples, float &peak, float &sum_sq)
+{
+  float p = 0, s = 0;
+  for (int i = 0; i < samples; i++) {
+    p = fmaxf(p, fabsf(data[i]));
+    s += data[i] * data[i];
+  }
+  peak = p;
+  sum_sq = s;
+}
+
+#ifdef __SSE2__
+static float hmax(__m128 v)
+{
+  v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+  return _mm_cvtss_f32(v);
+}
+
+static float hsum(__m128 v)
+{
+  v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+  return _mm_cvtss_f32(v);
+}
+
+static void block_levels_SSE2(const float *data, int samples, float &peak, float &sum_sq)
+{
+  const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 p0 = _mm_setzero_ps(), p1 = _mm_setzero_ps(),
+         s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= samples; i += 8) {
+    const __m128 a = _mm_loadu_ps(data + i),
+                 b = _mm_loadu_ps(data + i + 4);
+    p0 = _mm_max_ps(p0, _mm_and_ps(a, absmask));
+    p1 = _mm_max_ps(p1, _mm_and_ps(b, absmask));
+    s0 = _mm_add_ps(s0, _mm_mul_ps(a, a));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(b, b));
+  }
+  float p, s;
+  block_levels_C(data + i, samples - i, p, s);
+  peak = fmaxf(hmax(_mm_max_ps(p0, p1)), p);
+  sum_sq = hsum(_mm_add_ps(s0, s1)) + s;
+}
+
+__attribute__((target("avx")))
+static void block_levels_AVX(const float *data, int samples, float &peak, float &sum_sq)
+{
+  const __m256 absmask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  __m256 p0 = _mm256_setzero_ps(), p1 = _mm256_setzero_ps(),
+         s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= samples; i += 16) {
+    const __m256 a = _mm256_loadu_ps(data + i),
+                 b = _mm256_loadu_ps(data + i + 8);
+    p0 = _mm256_max_ps(p0, _mm256_and_ps(a, absmask));
+    p1 = _mm256_max_ps(p1, _mm256_and_ps(b, absmask));
+    s0 = _mm256_add_ps(s0, _mm256_mul_ps(a, a));
+    s1 = _mm256_add_ps(s1, _mm256_mul_ps(b, b));
+  }
+  const __m256 p8 = _mm256_max_ps(p0, p1),
+               s8 = _mm256_add_ps(s0, s1);
+  float p, s;
+  block_levels_SSE2(data + i, samples - i, p, s);
+  peak = fmaxf(hmax(_mm_max_ps(_mm256_castps256_ps128(p8), _mm256_extractf128_ps(p8, 1))), p);
+  sum_sq = hsum(_mm_add_ps(_mm256_castps256_ps128(s8), _mm256_extractf128_ps(s8, 1))) + s;
+}
+#endif
+
+void audio_block_levels(const float *data, int samples, float &peak, float &sum_sq)
+{
+#ifdef __SSE2__
+  static const bool has_avx = __builtin_cpu_supports("avx");
+  if (has_avx) {
+    block_levels_AVX(data, samples, peak, sum_sq);
+  } else {
+    block_levels_SSE2(data, samples, peak, sum_sq);
+  }
+#else
+  block_levels_C(data, samples, peak, sum_sq);
+#endif
+}
+
+void AudioMeters::update(const float *data, int channel_stride_in_bytes, int channels, int samples, int rate)
+{
+  if (channels <= 0 || samples <= 0 || rate <= 0) {
+    return;
+  }
+  if ((int)levels.size() != channels) {
+    levels.assign(channels, {});
+  }
+
+  const float dt = (float)samples / rate,
+              fall = powf(10.0f, -PEAK_FALL * dt / 20.0f),
+              alpha = 1.0f - expf(-dt / RMS_TAU);
+  for (int c = 0; c < channels; c++) {
+    float peak, sum_sq;
+    audio_block_levels((const float *)((const uint8_t *)data + (size_t)c * channel_stride_in_bytes), samples, peak, sum_sq);
+
+    level_t &l = levels[c];
+    l.peak = fmaxf(peak, l.peak * fall);
+    l.ms += (sum_sq / samples - l.ms) * alpha;
+    l.rms = sqrtf(l.ms);
+  }
+}
+
+// 0..1 on the meter scale
+static float meter_pos(float level)
+{
+  if (level <= 0) {
+    return 0;
+  }
+  const float pos = 1.0f + 20.0f * log10f(level) / METER_RANGE;
+  return (pos < 0) ? 0 : (pos > 1) ? 1 : pos;
+}
+
+static uint32_t meter_color(float pos)  // BGRA (opaque)
+{
+  if (pos > 1.0f - 6.0f / METER_RANGE) {
+    return 0xffff2020;
+  } else if (pos > 1.0f - 18.0f / METER_RANGE) {
+    return 0xffe0e020;
+  }
+  return 0xff20d020;
+}
+
+void AudioMeters::draw(uint8_t *bgrx, int stride, int width, int height, int y0, int rows) const
+{
+  const int num = (int)levels.size();
+  if (!num) {
+    return;
+  }
+  const int bar = (width / 100 > 3) ? width / 100 : 3,
+            margin = bar,
+            total = num * (bar + 1) + 1,  // (1 px gaps)
+            top = height / 10,
+            len = height - 2 * top;
+  const int x0 = width - margin - total;
+  if (x0 < 0 || len <= 0) {
+    return;
+  }
+  const int ya = std::max(top, y0), yb = std::min(top + len, y0 + rows);  // (visible part)
+
+  for (int y = ya; y < yb; y++) { // darken background (opaque, also on an ARGB visual)
+    uint8_t *row = bgrx + (size_t)(y - y0) * stride + x0 * 4;
+    for (int i = 0; i < total * 4; i += 4) {
+      row[i] >>= 2;
+      row[i + 1] >>= 2;
+      row[i + 2] >>= 2;
+      row[i + 3] = 0xff;
+    }
+  }
+
+  for (int c = 0; c < num; c++) {
+    const int x = x0 + 1 + c * (bar + 1),
+              rms_h = (int)(meter_pos(levels[c].rms) * len),
+              peak_y = top + len - 1 - (int)(meter_pos(levels[c].peak) * (len - 1));
+    for (int y = std::max(top + len - rms_h, ya); y < yb; y++) {
+      uint32_t *px = (uint32_t *)(bgrx + (size_t)(y - y0) * stride) + x;
+      const uint32_t col = meter_color(1.0f - (float)(y - top) / len);
+      for (int i = 0; i < bar; i++) {
+        px[i] = col;
+      }
+    }
+    if (levels[c].peak > 0 && peak_y >= ya && peak_y < yb) {
+      uint32_t *px = (uint32_t *)(bgrx + (size_t)(peak_y - y0) * stride) + x;
+      const uint32_t col = meter_color(1.0f - (float)(peak_y - top) / len);
+      for (int i = 0; i < bar; i++) {
+        px[i] = col;
+      }
+    }
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Per-channel audio levels with PPM-like ballistics (peak: instant attack, 20 dB/s fall; rms: 300 ms integration),
+// drawn as bars into a BGRX image.
+class AudioMeters {
+public:
+  void update(const float *data, int channel_stride_in_bytes, int channels, int samples, int rate);
+
+  // right edge of the image, -60..0 dBFS
+  // only rows [y0, y0 + rows) of the width x height image are touched, bgrx points at row y0
+  void draw(uint8_t *bgrx, int stride, int width, int height, int y0, int rows) const;
+
+  // (linear, 0..1+)
+  float peak(int channel) const { return levels[channel].peak; }
+  float rms(int channel) const { return levels[channel].rms; }
+  int channels() const { return (int)levels.size(); }
+
+private:
+  struct level_t {
+    float peak = 0, ms = 0, rms = 0;  // (ms: mean square)
+  };
+  std::vector<level_t> levels;
+};
+
+// SIMD helpers: max |x| and sum of x^2
+void audio_block_levels(const float *data, int samples, float &peak, float &sum_sq);
@@ -1,16 +1,37 @@
 #include "myui.h"
+#include <poll.h>
+#include <unistd.h>
 
-MyUI::MyUI(const char *name, int width, int height, bool gray)
+MyUI::prefetch_t::prefetch_t(XcbConnection &conn, bool gray)
+  : bgcol(gray ? conn.alloc_color(0x7f7f, 0x7f7f, 0x7f7f) : conn.alloc_color(0, 0, 0)),  // (note: cannot just use conn.black_pixel(), because XcbColor frees)
+    wmproto(conn.intern_atom("WM_PROTOCOLS")),
+    wmdel(conn.intern_atom("WM_DELETE_WINDOW")),
+    ewmh(conn)
+{
+  XcbImage::prefetch(conn);
+}
+
+MyUI::MyUI(const char *name, int width, int height, bool gray, bool want_argb)
   : conn(),
-    bgcol(gray ? conn.color(0x7f7f, 0x7f7f, 0x7f7f) : conn.color(0, 0, 0)),  // (note: cannot just use conn.black_pixel(), because XcbColor frees)
+    pre(conn, gray),
+    bgcol(conn.color(std::move(pre.bgcol))),
+    argb(want_argb ? conn.find_visualtype(32, 0xff0000, 0x00ff00, 0x0000ff) : std::pair<const xcb_visualtype_t *, uint8_t>()),
+    cmap(conn, conn.root_window(), argb.first ? argb.first->visual_id : 0),
     win(conn, conn.root_window(), width, height,
-      XCB_CW_EVENT_MASK, {
-        XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_STRUCTURE_NOTIFY
-      }),
-    gc(conn, win.get_window(), XCB_GC_FOREGROUND | XCB_GC_GRAPHICS_EXPOSURES, { bgcol, 0 }),
-    dmux(win.install_delete_handler()),
-    ewmh(conn),
-    img(conn, win.get_window(), 24),
+      XCB_CW_BORDER_PIXEL | XCB_CW_EVENT_MASK | XCB_CW_COLORMAP, {
+        0,  // (border: must be given for a visual other than the parent's)
+        XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_STRUCTURE_NOTIFY,
+        cmap
+      },
+      XCB_WINDOW_CLASS_INPUT_OUTPUT, 0, 0, 0,
+      argb.second, argb.first ? argb.first->visual_id : XCB_COPY_FROM_PARENT),  // (depth 0: copy from parent)
+    gc(conn, win.get_window(), XCB_GC_FOREGROUND | XCB_GC_GRAPHICS_EXPOSURES, {
+      argb.first ? (gray ? 0xff7f7f7fu : 0xff000000u) : (uint32_t)bgcol,  // (ARGB: opaque, bgcol is only valid for the default colormap)
+      0
+    }),
+    dmux(win.install_delete_handler(std::move(pre.wmproto), std::move(pre.wmdel))),
+    ewmh(conn, std::move(pre.ewmh)),
+    img(conn, win.get_window(), argb.first ? argb.second : conn.default_visualtype().second),
     img_width(0), img_height(0)
 {
   dmux.on_key_press(win.get_window(), [this](xcb_key_press_event_t *ev) {
@@ -19,9 +40,7 @@ MyUI::MyUI(const char *name, int width, int height, bool gray)
     else if (ev->detail == 0x29) { fullscr ^= 1; fullscreen(fullscr); } // 'f' ...        // FIXME?!
   });
 
-  // set window title
-  std::string title = name + std::string(" - xndiview");  // (NOTE: use esp. _NET_WM_NAME [-> XcbEWMH] for utf8 ...)
-  xcb_change_property(conn, XCB_PROP_MODE_REPLACE, win.get_window(), XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, title.size(), title.data());
+  set_title(name);
 
   dmux.on_wm_delete(win.get_window(), [this](xcb_client_message_event_t *ev) {
     done = true;
@@ -38,46 +57,88 @@ MyUI::MyUI(const char *name, int width, int height, bool gray)
   dmux.on_expose(win.get_window(), [this](xcb_expose_event_t *ev) {
     if (ev->count != 0) return;
 
-    if (cur.data) {
-      do_draw(true);
-    } else {
-      xcb_rectangle_t r = {0, 0, img_width, img_height};
-      xcb_poly_fill_rectangle(conn, win.get_window(), gc, 1, &r);  // (unchecked)
-      conn.flush();
-    }
+    dirty = need_clear = true;
   });
 
   win.map();
 }
 
+void MyUI::set_title(const char *name)
+{
+  std::string title = name + std::string(" - xndiview");  // (NOTE: use esp. _NET_WM_NAME [-> XcbEWMH] for utf8 ...)
+  xcb_change_property(conn, XCB_PROP_MODE_REPLACE, win.get_window(), XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, title.size(), title.data());
+}
+
 void MyUI::init_image()
 {
-  std::pair<const xcb_visualtype_t *, uint8_t> vtd = conn.default_visualtype();
+  std::pair<const xcb_visualtype_t *, uint8_t> vtd = argb.first ? argb : conn.default_visualtype();
   if (!vtd.first ||
-      vtd.second != 24 ||
-      vtd.first->_class != XCB_VISUAL_CLASS_TRUE_COLOR ||
-      vtd.first->bits_per_rgb_value != 8 ||    // ? colormap_entries = 256 ?
-      vtd.first->red_mask != 0xff0000 ||
-      vtd.first->green_mask != 0x00ff00 ||
-      vtd.first->blue_mask != 0x0000ff) {   // --> NOTE: corresponds to BGRX in ndi
+      vtd.first->_class != XCB_VISUAL_CLASS_TRUE_COLOR) {
     throw std::runtime_error("Unsupported visualtype");
   }
 
   const xcb_format_t *vf = conn.format(vtd.second);
-  if (!vf ||
-      vf->bits_per_pixel != 32) {
+  if (!vf) {
     throw std::runtime_error("Unsupported format for depth");
   }
+
+  // resolved once (throws for anything else than 24 bit BGRX / RGBX, 32 bit ARGB, 16 bit RGB565, 30 bit 2:10:10:10)
+  outfmt = pixfmt_of_visual(vtd.second, vf->bits_per_pixel,
+                            vtd.first->red_mask, vtd.first->green_mask, vtd.first->blue_mask,
+                            xcb_get_setup(conn)->image_byte_order == XCB_IMAGE_ORDER_MSB_FIRST);
 }
 
 bool MyUI::run_once()
 {
-  return conn.run_once([this](xcb_generic_event_t *ev) {
-    dmux.emit(ev);
-    return !done;
-  });
+  // event phase: handlers only update state, even an expose storm or repeated toggles cost just one render
+  if (!conn.run_once([this](xcb_generic_event_t *ev) {
+        dmux.emit(ev);
+        return !done;
+      })) {
+    return false;
+  }
+
+  if (dirty) {
+    render();
+  }
+
+  FrcScheduler::pick_t pick;
+  if (frc && frc->tick(pick) && !(pick == shown)) {
+    frc_present(pick);
+  }
+  return true;
+}
+
+void MyUI::render()
+{
+  if (frc && cur.data) {
+    frc_render();
+    dirty = fresh = false;  // (need_clear: by next present)
+    return;
+  }
+
+  if (cur.data) {
+    do_draw(need_clear);
+    if (fresh && presented) { // (not for redraws of the same frame)
+      presented(cur.timestamp);
+    }
+  } else if (need_clear) {
+    xcb_rectangle_t r = {0, 0, img_width, img_height};
+    xcb_poly_fill_rectangle(conn, win.get_window(), gc, 1, &r);  // (unchecked)
+    conn.flush();
+  }
+  dirty = fresh = need_clear = false;
+}
+
+void MyUI::wait(int timeout_ms)
+{
+  conn.flush();
+  struct pollfd pfd = { conn.fd(), POLLIN, 0 };
+  poll(&pfd, 1, timeout_ms);  // (EINTR etc. is just an early return)
 }
 
+#include "colorspace.h"
+#include "libyuv/planar_functions.h"
 #include "libyuv/scale_argb.h"
 #include <assert.h>
 
@@ -99,30 +160,118 @@ imgfit_t::imgfit_t(int sw, int sh, int width, int height)
   }
 }
 
-void MyUI::do_draw(bool clear)
+imgfit_t MyUI::fit() const
 {
-  if (img_width == 0 || img_height == 0) {
+  return {cur.xres, Deinterlacer::frame_height(cur.field, cur.yres), img_width, img_height};
+}
+
+// rows per strip: the strip's working set (row_bytes per row: source rows read, BGRA rows written, packed rows) stays in L2,
+// but at least one strip per task
+static int strip_rows(size_t row_bytes, int height, int tasks)
+{
+  static const size_t l2 = [] {
+    const long val = sysconf(_SC_LEVEL2_CACHE_SIZE);  // (per core; 0 / -1 e.g. in some VMs)
+    return (val > 0) ? (size_t)val : 256 * 1024;
+  }();
+  const int rows = (int)(l2 / 2 / std::max<size_t>(row_bytes, 1));
+  return std::max(std::min(rows, (height + tasks - 1) / tasks), 8);  // (too few rows: per-call overhead of libyuv dominates)
+}
+
+// fn(y0, y1) per strip of rows, across the pool (if any)
+template <typename Fn>
+static void for_strips(WorkerPool *pool, int height, int rows, Fn &&fn)
+{
+  if (pool) {
+    pool->parallel_for(height, rows, fn);
     return;
   }
+  for (int y0 = 0; y0 < height; y0 += rows) {
+    fn(y0, std::min(y0 + rows, height));
+  }
+}
 
-  const imgfit_t fit{cur.xres, cur.yres, img_width, img_height};
-  uint8_t *dst;
-  if (!img.has(fit.dw, fit.dh)) {
-    clear = true;
-    dst = (uint8_t *)img.data(fit.dw, fit.dh);
-  } else {
-    dst = (uint8_t *)img.data();
+static void set_opaque(uint8_t *bgra, int stride, int width, int height)
+{
+  for (int y = 0; y < height; y++) {
+    uint32_t *px = (uint32_t *)(bgra + (size_t)y * stride);
+    for (int x = 0; x < width; x++) { // (auto-vectorized)
+      px[x] |= 0xff000000;
+    }
+  }
+}
+
+bool MyUI::alpha_pass()
+{
+  if (!transparency) {
+    return false;
   }
-  const int res = libyuv::ARGBScale(
-    cur.data, cur.stride, cur.xres, cur.yres,
-    dst, img.stride(), fit.dw, fit.dh,
+  if (cur.alpha == FrameAlpha::UNKNOWN) { // (once per frame)
+    cur.alpha = bgra_opaque(cur.data, cur.stride, cur.xres, cur.yres) ? FrameAlpha::OPAQUE : FrameAlpha::TRANSLUCENT;
+  }
+  if (cur.alpha != FrameAlpha::TRANSLUCENT) { // (NONE: X bytes are not alpha)
+    astats.opaque++;
+    return false;
+  }
+  astats.blended++;
+  return true;
+}
+
+// deinterlaced BGRA frame; draw_yuv(): no data, scale_rows() converts the rows of each strip
+Deinterlacer::view_t MyUI::source(int out_height)
+{
+  if (cur.yuv) {
+    yuv_strips.resize(pool ? pool->size() : 1);
+    return { nullptr, cur.xres * 4, cur.yres };
+  }
+  return deint.process(cur.data, cur.stride, cur.xres, cur.yres, cur.field, out_height);
+}
+
+// incl. deinterlacing, LUT and transparency (in strips, like output())
+void MyUI::scale(uint8_t *dst, int dst_stride, const imgfit_t &fit)
+{
+  const Deinterlacer::view_t src = source(fit.dh);
+  const bool blend = alpha_pass();
+  const int tasks = pool ? pool->size() : 1,
+            rows = strip_rows((size_t)src.stride * src.rows / fit.dh + dst_stride, fit.dh, tasks);
+  for_strips(pool, fit.dh, rows, [&](int y0, int y1) {
+    scale_rows(dst + (size_t)y0 * dst_stride, dst_stride, fit, src, y0, y1 - y0, blend);
+  });
+}
+
+// dst points at row y0; blend: frame has translucent pixels and transparency is shown
+void MyUI::scale_rows(uint8_t *dst, int dst_stride, const imgfit_t &fit, const Deinterlacer::view_t &src, int y0, int rows, bool blend)
+{
+  const uint8_t *src_data = src.data;
+  if (cur.yuv) { // source rows of this strip (+ 2 rows margin for the filter taps / rounding of libyuv's 16.16 steps)
+    const int sy0 = std::max((int)((int64_t)y0 * src.rows / fit.dh) - 2, 0),
+              sy1 = std::min((int)(((int64_t)(y0 + rows) * src.rows + fit.dh - 1) / fit.dh) + 2, src.rows);
+    std::vector<uint8_t> &buf = yuv_strips[WorkerPool::current()];
+    buf.resize((size_t)(sy1 - sy0 + 1) * src.stride);  // (+ 1: row past the last one is read, with weight 0)
+    cur.yuv->convert_rows(cur.data, cur.stride, cur.fourcc, cur.xres, cur.yres, sy0, sy1 - sy0, buf.data(), src.stride);
+    src_data = buf.data() - (ptrdiff_t)sy0 * src.stride;  // (libyuv only reads rows of the clip window)
+  }
+
+  const int res = libyuv::ARGBScaleClip(
+    src_data, src.stride, cur.xres, src.rows,
+    dst - (ptrdiff_t)y0 * dst_stride, dst_stride, fit.dw, fit.dh,  // (libyuv adds y0 * dst_stride again)
+    0, y0, fit.dw, rows,
     libyuv::kFilterBilinear);
   assert(res == 0);
 
-  if (transparency) { // TODO/FIXME: SSSE3, AVX2, NEON, ... version ? ...  // TODO? elsewhere ?
+  if (lut) { // (destination size: usually fewer pixels than the source)
+    lut->apply_rows(dst, dst_stride, fit.dw, rows);  // (already within a strip task)
+  }
+
+  if (outfmt.format == PixelFormat::BGRA) { // (ARGB visual: the compositing manager blends, expects premultiplied alpha)
+    if (blend) {
+      libyuv::ARGBAttenuate(dst, dst_stride, dst, dst_stride, fit.dw, rows);
+    } else if (cur.alpha != FrameAlpha::OPAQUE) { // (incl. BGRX: X bytes may be anything)
+      set_opaque(dst, dst_stride, fit.dw, rows);
+    }
+  } else if (blend) { // checkerboard  // TODO/FIXME: SSSE3, AVX2, NEON, ... version ? ...  // TODO? elsewhere ?
     // + pre-multiplies (Attenuate)
     uint8_t *row = dst;
-    for (int y = 0; y < fit.dh; y++) {
+    for (int y = y0; y < y0 + rows; y++) {
       uint8_t *rgba = row;
       for (int x = 0; x < fit.dw; x++) {
         if (rgba[3] == 0xff) {
@@ -137,10 +286,13 @@ void MyUI::do_draw(bool clear)
         rgba[2] = (uint8_t)(rgba[2] * alpha + bgcol * ialpha);
         rgba += 4;
       }
-      row += img.stride();
+      row += dst_stride;
     }
   }
+}
 
+void MyUI::put(const imgfit_t &fit, bool clear)
+{
   if (clear) {
 #if 0
     xcb_rectangle_t r = {0, 0, img_width, img_height};
@@ -160,3 +312,117 @@ void MyUI::do_draw(bool clear)
   img.put(win.get_window(), fit.dx, fit.dy);
 }
 
+template <typename Produce>
+void MyUI::output(const imgfit_t &fit, bool clear, size_t in_row_bytes, Produce &&produce)
+{
+  uint8_t *dst;
+  if (!img.has(fit.dw, fit.dh)) {
+    clear = true;
+    dst = (uint8_t *)img.data(fit.dw, fit.dh);
+  } else {
+    dst = (uint8_t *)img.data();
+  }
+
+  const bool native = outfmt.native();
+  const size_t strip_stride = (size_t)fit.dw * 4;
+  const int tasks = pool ? pool->size() : 1,
+            rows = strip_rows(in_row_bytes + strip_stride + (native ? 0 : img.stride()), fit.dh, tasks);
+  if (!native) {
+    strips.resize(tasks);
+    for (std::vector<uint8_t> &strip : strips) {
+      strip.resize(strip_stride * rows);
+    }
+  }
+
+  // all stages per strip (scale / blend, LUT, alpha, overlay, pack), while it is still in cache
+  for_strips(pool, fit.dh, rows, [&](int y0, int y1) {
+    const int n = y1 - y0;
+    uint8_t *out = dst + (size_t)y0 * img.stride();
+    if (native) {
+      produce(out, img.stride(), y0, n);
+      if (overlay) {
+        overlay(out, img.stride(), fit.dw, fit.dh, y0, n);
+      }
+      return;
+    }
+    uint8_t *bgrx = strips[WorkerPool::current()].data();  // (per thread)
+    produce(bgrx, strip_stride, y0, n);
+    if (overlay) {
+      overlay(bgrx, strip_stride, fit.dw, fit.dh, y0, n);
+    }
+    for (int y = 0; y < n; y++) {
+      pack_row(outfmt, bgrx + y * strip_stride, out + (size_t)y * img.stride(), fit.dw);
+    }
+  });
+  put(fit, clear);
+}
+
+void MyUI::do_draw(bool clear)
+{
+  if (img_width == 0 || img_height == 0) {
+    return;
+  }
+
+  const imgfit_t fit = this->fit();
+  const Deinterlacer::view_t src = source(fit.dh);
+  const bool blend = alpha_pass();
+  output(fit, clear, (size_t)src.stride * src.rows / fit.dh, [&](uint8_t *bgrx, int stride, int y0, int rows) {
+    scale_rows(bgrx, stride, fit, src, y0, rows, blend);
+  });
+}
+
+void MyUI::frc_render()
+{
+  if (fresh) {
+    cur_slot = frc->push(cur.timestamp, cur.fps_n, cur.fps_d);
+  }
+  if (img_width == 0 || img_height == 0 || cur_slot < 0) {
+    return;
+  }
+
+  // (not fresh: expose, resize, toggles -> only the newest frame is rescaled, older ones are skipped until replaced)
+  const imgfit_t fit = this->fit();
+  scaled_t &dst = scaled[cur_slot];
+  dst.data.resize((size_t)fit.dw * fit.dh * 4);
+  dst.width = fit.dw;
+  dst.height = fit.dh;
+  if (fresh) {
+    dst.timestamp = cur.timestamp;
+  }
+  scale(dst.data.data(), fit.dw * 4, fit);
+  shown = {};
+}
+
+void MyUI::frc_present(const FrcScheduler::pick_t &pick)
+{
+  const imgfit_t fit = this->fit();
+  const scaled_t &a = scaled[pick.a];
+  if (a.width != fit.dw || a.height != fit.dh) {
+    return;  // (scaled before resize)
+  }
+  const scaled_t *b = (pick.b >= 0) ? &scaled[pick.b] : nullptr;
+  if (b && (b->width != a.width || b->height != a.height)) {
+    b = nullptr;
+  }
+  output(fit, need_clear, (size_t)a.width * 4 * (b ? 2 : 1), [&](uint8_t *bgrx, int stride, int y0, int rows) {
+    const size_t offset = (size_t)y0 * a.width * 4;
+    int res;
+    if (b) {
+      res = libyuv::ARGBInterpolate(a.data.data() + offset, a.width * 4, b->data.data() + offset, b->width * 4,
+                                    bgrx, stride, fit.dw, rows, pick.frac);
+    } else {
+      res = libyuv::ARGBCopy(a.data.data() + offset, a.width * 4, bgrx, stride, fit.dw, rows);
+    }
+    assert(res == 0);
+  });
+  need_clear = false;
+  shown = pick;
+
+  if (presented) {
+    int64_t timestamp = a.timestamp;
+    if (b && a.timestamp && b->timestamp) {
+      timestamp += (b->timestamp - a.timestamp) * pick.frac / 256;
+    }
+    presented(timestamp);
+  }
+}
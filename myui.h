@@ -4,31 +4,125 @@
 #include "xcbcpp/xcb_img.h"
 
 #include "xcbcpp/xcbdemuxwm.h"
+#include "colorspace.h"
+#include "deinterlace.h"
+#include "frc.h"
+#include "lut3d.h"
+#include "pixfmt.h"
+#include "workers.h"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+struct imgfit_t;
 
 class MyUI {
 public:
-  MyUI(const char *name = "", int width = 480, int height = 270, bool gray = false);
-  MyUI(const char *name, bool gray) : MyUI(name, 480, 270, gray) {}
+  // argb: window on a depth 32 ARGB visual (if there is one), transparency is then blended by the compositing manager
+  MyUI(const char *name = "", int width = 480, int height = 270, bool gray = false, bool argb = false);
+  MyUI(const char *name, bool gray, bool argb = false) : MyUI(name, 480, 270, gray, argb) {}
 
+  // handles all pending events, then renders once if anything changed (and presents, when a refresh tick is due)
   bool run_once();
 
-  void draw(const uint8_t *data, int stride, int xres, int yres) {
+  // waits until X events are available or timeout_ms passed (-1: no timeout)
+  void wait(int timeout_ms);
+
+  // field: single fields have half height (yres), the window still shows the full frame
+  // timestamp (100 ns), fps: only used for frame-rate conversion, 0: untimed
+  // alpha: as known from the converter; UNKNOWN is scanned once, when transparency is shown
+  void draw(const uint8_t *data, int stride, int xres, int yres, field_t field = FIELD_NONE,
+            int64_t timestamp = 0, int fps_n = 0, int fps_d = 0, FrameAlpha alpha = FrameAlpha::UNKNOWN) {
     // assert(data);
     cur.data = data;
     cur.stride = stride;
     cur.xres = xres;
     cur.yres = yres;
-    do_draw(false);
+    cur.field = field;
+    cur.timestamp = timestamp;
+    cur.fps_n = fps_n;
+    cur.fps_d = fps_d;
+    cur.alpha = alpha;
+    cur.yuv = nullptr;
+    dirty = fresh = true;  // (rendered by next run_once())
+  }
+
+  // progressive UYVY / P216 frame (after yuv.prepare_rows()), nobody else needs as BGRA: converted while rendering,
+  // per strip only the source rows it scales from, into a small per-thread buffer (no full-frame BGRA pass)
+  // NOTE: data and yuv must stay valid until the next draw
+  void draw_yuv(const YuvConverter &yuv, const uint8_t *data, int stride, uint32_t fourcc, int xres, int yres,
+                int64_t timestamp = 0, int fps_n = 0, int fps_d = 0) {
+    draw(data, stride, xres, yres, FIELD_NONE, timestamp, fps_n, fps_d, FrameAlpha::OPAQUE);
+    cur.yuv = &yuv;
+    cur.fourcc = fourcc;
+  }
+
+  // present at display refresh rate hz (repeat / drop / blend frames), instead of whenever a frame arrives
+  // NOTE: ticks are timer-based (no vsync)
+  void set_refresh(double hz) {
+    frc.reset(new FrcScheduler(hz));
+  }
+  // timeout_ms, shortened to the next tick (when set_refresh() is used)
+  int until_tick(int timeout_ms) const {
+    return (frc) ? std::min(timeout_ms, frc->until_tick()) : timeout_ms;
+  }
+
+  // drawn into the scaled image right before it is put (e.g. audio meters);
+  // called for rows [y0, y0 + rows) of the width x height image at a time, bgrx points at row y0
+  // NOTE: called concurrently for different rows (from the worker pool)
+  using overlay_t = std::function<void(uint8_t *bgrx, int stride, int width, int height, int y0, int rows)>;
+  void set_overlay(overlay_t fn) {
+    overlay = std::move(fn);
+  }
+
+  // called with the source timestamp (100 ns) of each new picture when it is put on screen, e.g. for lip sync;
+  // -R: of the presented (or, blended, interpolated) frame, i.e. incl. the latency of the frame-rate conversion
+  void on_present(std::function<void(int64_t timestamp)> fn) {
+    presented = std::move(fn);
+  }
+
+  // rendering is split into strips across the pool (nullptr: on the calling thread only)
+  void set_workers(WorkerPool *val) {
+    pool = val;
+  }
+
+  // display LUT, applied to the scaled image (nullptr: none)
+  void set_lut(std::unique_ptr<Lut3d> val) {
+    lut = std::move(val);
+    dirty = true;
+  }
+
+  void set_deinterlace(Deinterlace mode) {
+    deint.set_mode(mode);
+    dirty = true;
   }
 
   void fullscreen(bool val) {
     fullscr = val;
     ewmh.fullscreen(win.get_window(), val);
   }
+  bool is_fullscreen() const { return fullscr; }
 
   void show_transparency(bool val) {
     transparency = val;
-    do_draw(false);
+    dirty = true;
+  }
+  bool is_transparent() const { return transparency; }
+  bool is_argb() const { return argb.first != nullptr; }  // (else: transparency is shown on a checkerboard)
+
+  // renders while transparency is shown: opaque frames skip all alpha work (checkerboard / premultiplication)
+  struct alpha_stats_t {
+    uint64_t opaque = 0, blended = 0;
+  };
+  const alpha_stats_t &alpha_stats() const { return astats; }
+
+  void set_title(const char *name);
+
+  // additional key handler (e.g. for replay), keycode-based like the built-in ones
+  template <typename Fn>
+  Connection on_key_press(Fn&& fn) {
+    return dmux.on_key_press(win.get_window(), (Fn&&)fn);
   }
 
   void close() { // TODO?
@@ -37,7 +131,19 @@ public:
 
 private:
   XcbConnection conn;
+
+  // all startup queries are issued at once, the members below then only collect the replies
+  struct prefetch_t {
+    prefetch_t(XcbConnection &conn, bool gray);
+
+    XcbFuture<xcb_alloc_color_request_t> bgcol;
+    XcbAtomFuture wmproto, wmdel;
+    XcbEWMH::Atoms ewmh;
+  } pre;
+
   XcbColor bgcol;
+  std::pair<const xcb_visualtype_t *, uint8_t> argb;  // (0, 0): default visual
+  XcbColormap cmap;
   XcbWindow win;
   XcbGC gc;
   XcbDemuxWithWM dmux;
@@ -45,17 +151,63 @@ private:
   XcbEWMH ewmh;
 
   XcbImage img;
+  pixfmt_t outfmt;  // (of the default visual)
   void init_image();
   uint16_t img_width, img_height;
 
   bool transparency = false;
+  Deinterlacer deint;
+  std::unique_ptr<Lut3d> lut;
+  overlay_t overlay;
+  std::function<void(int64_t timestamp)> presented;
 
   struct {
     const uint8_t *data;
     int stride, xres, yres;
+    field_t field;
+    int64_t timestamp;
+    int fps_n, fps_d;
+    FrameAlpha alpha;
+    const YuvConverter *yuv;  // (draw_yuv(): data is not BGRA)
+    uint32_t fourcc;
   } cur = { 0 };
   void do_draw(bool clear);
 
+  alpha_stats_t astats;
+  bool alpha_pass();  // (per render: is any alpha work needed?)
+
+  imgfit_t fit() const;
+  Deinterlacer::view_t source(int out_height);
+  std::vector<std::vector<uint8_t>> yuv_strips;  // (draw_yuv(): per thread)
+  void scale(uint8_t *dst, int dst_stride, const imgfit_t &fit);
+  void scale_rows(uint8_t *dst, int dst_stride, const imgfit_t &fit, const Deinterlacer::view_t &src, int y0, int rows, bool blend);
+
+  // strips sized to L2, handed out across the pool (parallel_for)
+  WorkerPool *pool = nullptr;
+
+  // produce(bgrx, stride, y0, rows) writes the scaled BGRX rows [y0, y0 + rows), then the overlay is drawn, strip by strip;
+  // non-BGRX visuals: into a small per-thread buffer, packed into the image right away (no extra full-frame pass)
+  // in_row_bytes: source bytes read by produce per output row (for the strip height)
+  template <typename Produce>
+  void output(const imgfit_t &fit, bool clear, size_t in_row_bytes, Produce &&produce);
+  std::vector<std::vector<uint8_t>> strips;
+  void put(const imgfit_t &fit, bool clear);
+
+  // frame-rate conversion: source frames are scaled once into their slot, ticks only copy or blend
+  std::unique_ptr<FrcScheduler> frc;
+  struct scaled_t {
+    std::vector<uint8_t> data;
+    int width = 0, height = 0;
+    int64_t timestamp = 0;
+  } scaled[FrcScheduler::num_slots];
+  int cur_slot = -1;
+  FrcScheduler::pick_t shown;  // (a = -1: must present)
+  void frc_render();
+  void frc_present(const FrcScheduler::pick_t &pick);
+
+  bool dirty = false, fresh = false, need_clear = false;
+  void render();
+
   bool fullscr = false;
   bool done = false;
 };
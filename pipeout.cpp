@@ -0,0 +1,291 @@
+#include "pipeout.h"
+#include "libyuv/convert_from_argb.h"
+#include "libyuv/planar_functions.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>  // IOV_MAX
+#include <poll.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+
+// (FourCC values as in NDIlib_FourCC_video_type_e)
+#define FOURCC_UYVY  0x59565955  // 'UYVY'
+#define FOURCC_UYVA  0x41565955  // 'UYVA' (alpha plane is not output)
+#define FOURCC_P216  0x36313250  // 'P216' (16 bit Y plane, then Cb/Cr plane: same stride)
+#define FOURCC_PA16  0x36314150  // 'PA16' (P216 + 16 bit alpha plane)
+#define FOURCC_BGRA  0x41524742  // 'BGRA'
+#define FOURCC_BGRX  0x58524742  // 'BGRX'
+
+static int bytes_per_pixel(uint32_t fourcc)
+{
+  switch (fourcc) {
+  case FOURCC_UYVY:
+  case FOURCC_UYVA:
+  case FOURCC_P216:
+  case FOURCC_PA16:
+    return 2;
+  case FOURCC_BGRA:
+  case FOURCC_BGRX:
+    return 4;
+  }
+  return 0;
+}
+
+// planes of equal size and stride, stored back to back
+static int num_planes(uint32_t fourcc)
+{
+  switch (fourcc) {
+  case FOURCC_P216: return 2;
+  case FOURCC_PA16: return 3;
+  }
+  return 1;
+}
+
+// 16 -> 8 bit (rounded), Cb/Cr deinterleaved
+static void p216_to_i422(const uint8_t *src, int stride, uint8_t *dst_y, uint8_t *dst_u, uint8_t *dst_v, int xres, int yres)
+{
+  const int hw = (xres + 1) / 2;
+  for (int y = 0; y < yres; y++) {
+    const uint16_t *sy = (const uint16_t *)(src + (size_t)y * stride),
+                   *suv = (const uint16_t *)(src + (size_t)(yres + y) * stride);
+    for (int x = 0; x < xres; x++) {
+      dst_y[x] = std::min(sy[x] + 128, 0xffff) >> 8;
+    }
+    for (int x = 0; x < hw; x++) {
+      dst_u[x] = std::min(suv[2 * x] + 128, 0xffff) >> 8;
+      dst_v[x] = std::min(suv[2 * x + 1] + 128, 0xffff) >> 8;
+    }
+    dst_y += xres;
+    dst_u += hw;
+    dst_v += hw;
+  }
+}
+
+static const char y4m_frame[] = "FRAME\n";
+
+PipeOutput::PipeOutput(int fd, Format format)
+  : fd(fd), format(format)
+{
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  thread = std::thread(&PipeOutput::writer, this);
+}
+
+PipeOutput::~PipeOutput()
+{
+  close();
+  ::close(fd);
+}
+
+void PipeOutput::close()
+{
+  if (!thread.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stop = true;
+  }
+  cv.notify_one();
+  thread.join();
+
+  std::lock_guard<std::mutex> lock(mtx);
+  done = wpos = tail;
+}
+
+void PipeOutput::start(const frame_t &frame)
+{
+  xres = frame.xres;
+  yres = frame.yres;
+
+  size_t frame_size;
+  if (format == Y4M) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C422\n",
+             xres, yres,
+             (frame.fps_n > 0) ? frame.fps_n : 30, (frame.fps_d > 0) ? frame.fps_d : 1);
+    header = buf;
+    frame_size = sizeof(y4m_frame) - 1 + (size_t)(xres + (xres + 1) / 2 * 2) * yres;
+  } else if (format == RAW) {
+    frame_size = (size_t)xres * 4 * yres;
+  } else {
+    frame_size = (size_t)xres * bytes_per_pixel(frame.fourcc) * yres * num_planes(frame.fourcc);
+  }
+
+  // the whole frame should fit into the pipe, otherwise the reader sees it in chunks anyway (-> only a hint, ignore errors)
+  if (fcntl(fd, F_SETPIPE_SZ, (int)std::min<size_t>(frame_size, INT_MAX)) == -1) {
+    fcntl(fd, F_SETPIPE_SZ, 1024 * 1024);  // (default /proc/sys/fs/pipe-max-size)
+  }
+
+  started = true;
+}
+
+bool PipeOutput::push(const frame_t &frame, void *token)
+{
+  if (error || !bytes_per_pixel(frame.fourcc)) {
+    num_dropped++;
+    return false;
+  }
+  if (!started) {
+    start(frame);
+  } else if (frame.xres != xres || frame.yres != yres) {  // (neither raw nor y4m can signal a format change)
+    num_dropped++;
+    return false;
+  }
+
+  std::unique_lock<std::mutex> lock(mtx);
+  if (tail > wpos ||  // writer is still busy: do not queue more than one frame
+      tail - head >= max_frames) {
+    num_dropped++;
+    return false;
+  }
+  entry_t &e = entries[tail % max_frames];
+  lock.unlock();  // (slot at tail is ours until tail is incremented)
+
+  e.frame = frame;
+  bool held = false;
+  if (format == Y4M) {
+    const int hw = (xres + 1) / 2;
+    e.buf.resize((size_t)(xres + 2 * hw) * yres);  // (no-op after first frame)
+    uint8_t *dst_y = e.buf.data(),
+            *dst_u = dst_y + (size_t)xres * yres,
+            *dst_v = dst_u + (size_t)hw * yres;
+    if (frame.fourcc == FOURCC_UYVY || frame.fourcc == FOURCC_UYVA) {
+      libyuv::UYVYToI422(frame.data, frame.stride, dst_y, xres, dst_u, hw, dst_v, hw, xres, yres);
+    } else if (frame.fourcc == FOURCC_P216 || frame.fourcc == FOURCC_PA16) {
+      p216_to_i422(frame.data, frame.stride, dst_y, dst_u, dst_v, xres, yres);
+    } else {
+      libyuv::ARGBToI422(frame.data, frame.stride, dst_y, xres, dst_u, hw, dst_v, hw, xres, yres);
+    }
+    e.frame.data = e.buf.data();
+    e.token = nullptr;
+  } else if (format == RAW && bytes_per_pixel(frame.fourcc) != 4) {
+    const YuvConverter::view_t img = yuv.convert(frame.data, frame.stride, frame.fourcc, xres, yres);
+    e.buf.resize((size_t)xres * 4 * yres);
+    libyuv::ARGBCopy(img.data, img.stride, e.buf.data(), xres * 4, xres, yres);
+    e.frame.data = e.buf.data();
+    e.frame.stride = xres * 4;
+    e.frame.fourcc = (frame.fourcc == FOURCC_UYVA || frame.fourcc == FOURCC_PA16) ? FOURCC_BGRA : FOURCC_BGRX;
+    e.token = nullptr;
+  } else {
+    e.token = token;
+    held = true;
+  }
+
+  lock.lock();
+  tail++;
+  lock.unlock();
+  cv.notify_one();
+  return held;
+}
+
+void PipeOutput::writer()
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  while (!stop) {
+    if (wpos < tail) {
+      entry_t &e = entries[wpos % max_frames];
+      lock.unlock();
+      const bool res = write_entry(e);
+      lock.lock();
+      if (!res) {
+        if (!stop) { // error: stream is broken, give everything back
+          done = wpos = tail;
+        }
+        break;
+      }
+      e.end = written;
+      wpos++;
+      num_frames++;
+      update_done();
+    } else if (done < wpos) {
+      cv.wait_for(lock, std::chrono::milliseconds(2));
+      update_done();
+    } else {
+      cv.wait(lock);
+    }
+  }
+}
+
+// called with mtx locked
+void PipeOutput::update_done()
+{
+  uint64_t consumed = written;
+  int pending;
+  if (use_splice && ioctl(fd, FIONREAD, &pending) == 0) {
+    consumed -= pending;
+  }
+  while (done < wpos && entries[done % max_frames].end <= consumed) {
+    done++;
+  }
+}
+
+bool PipeOutput::write_entry(entry_t &e)
+{
+  iovs.clear();
+  if (!header_sent) {
+    if (!header.empty()) {
+      iovs.push_back({ (void *)header.data(), header.size() });
+    }
+    header_sent = true;
+  }
+
+  const frame_t &f = e.frame;
+  if (format == Y4M) {
+    iovs.push_back({ (void *)y4m_frame, sizeof(y4m_frame) - 1 });
+    iovs.push_back({ (void *)f.data, e.buf.size() });
+  } else {
+    const size_t row = (size_t)f.xres * bytes_per_pixel(f.fourcc);
+    const int rows = f.yres * num_planes(f.fourcc);
+    if ((size_t)f.stride == row) {
+      iovs.push_back({ (void *)f.data, row * rows });
+    } else {
+      for (int y = 0; y < rows; y++) {
+        iovs.push_back({ (void *)(f.data + (size_t)y * f.stride), row });
+      }
+    }
+  }
+
+  return write_iov(iovs.data(), iovs.size());
+}
+
+bool PipeOutput::write_iov(struct iovec *iov, size_t cnt)
+{
+  while (cnt > 0) {
+    const size_t n = std::min<size_t>(cnt, IOV_MAX);
+    const ssize_t res = (use_splice) ? vmsplice(fd, iov, n, 0) : writev(fd, iov, n);
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN) {  // pipe full: reader is slow (push() drops meanwhile)
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        poll(&pfd, 1, 100);
+        if (stop) {
+          return false;
+        }
+        continue;
+      } else if (use_splice && (errno == EBADF || errno == EINVAL)) {  // not a pipe
+        use_splice = false;
+        continue;
+      }
+      error = errno;
+      return false;
+    }
+
+    written += res;
+    size_t len = res;
+    while (cnt > 0 && len >= iov->iov_len) {
+      len -= iov->iov_len;
+      iov++;
+      cnt--;
+    }
+    if (len) {
+      iov->iov_base = (uint8_t *)iov->iov_base + len;
+      iov->iov_len -= len;
+    }
+  }
+  return true;
+}
+
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "colorspace.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streams frames as raw video (BGRX, or BGRA for sources with alpha; rows packed), raw video in the native FourCC,
+// or Y4M (planar 4:2:2, 8 bit) into a pipe/FIFO/file.
+// Pipes get the data via vmsplice(), i.e. the kernel references the frame pages instead of copying them:
+// frames that need no conversion are therefore *held* (see push()) until the reader has consumed them.
+// A separate writer thread blocks on the pipe; when it cannot keep up, push() drops frames instead of waiting.
+class PipeOutput {
+public:
+  enum Format { RAW, NATIVE, Y4M };
+
+  struct frame_t {
+    const uint8_t *data;
+    int stride, xres, yres;
+    uint32_t fourcc;    // BGRA/BGRX, UYVY/UYVA or P216/PA16 (NDIlib_FourCC_video_type_e)
+    int fps_n, fps_d;
+  };
+
+  // takes ownership of fd (switched to non-blocking)
+  PipeOutput(int fd, Format format);
+  ~PipeOutput();
+
+  PipeOutput(const PipeOutput &) = delete;
+  PipeOutput &operator=(const PipeOutput &) = delete;
+
+  // RAW: YUV sources are converted as for display
+  void set_conversion(colorspace_t cs, bool dither) {
+    yuv.set_colorspace(cs);
+    yuv.set_dither(dither);
+  }
+
+  static constexpr size_t max_frames = 3;  // held at most
+
+  // true: frame data is referenced until token is passed to the release fn of collect().
+  // false: dropped or already copied, caller keeps ownership
+  bool push(const frame_t &frame, void *token);
+
+  // calls release(token) for all held frames that were consumed by the reader
+  template <typename Fn>
+  void collect(Fn&& release) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (; head < done; head++) {
+      entry_t &e = entries[head % max_frames];
+      if (e.token) {
+        release(e.token);
+        e.token = nullptr;
+      }
+    }
+  }
+
+  // stops writer, afterwards collect() releases all remaining frames
+  // NOTE: data still in the pipe might change after release
+  void close();
+
+  uint64_t frames() const { return num_frames; }
+  uint64_t dropped() const { return num_dropped; }
+  bool failed() const { return error != 0; }
+
+private:
+  struct entry_t {
+    frame_t frame;        // Y4M, RAW from YUV: converted copy in buf
+    void *token = nullptr;
+    std::vector<uint8_t> buf;
+    uint64_t end = 0;     // value of `written` after this frame
+  };
+
+  void start(const frame_t &frame);  // y4m stream header, pipe size
+  void writer();
+  bool write_entry(entry_t &e);
+  bool write_iov(struct iovec *iov, size_t cnt);
+  void update_done();
+
+  int fd;
+  Format format;
+  bool use_splice = true;
+  bool started = false;
+  int xres = 0, yres = 0;
+  std::string header;  // (must stay unchanged once spliced)
+  YuvConverter yuv;    // (RAW)
+
+  entry_t entries[max_frames];
+  uint64_t head = 0, done = 0, wpos = 0, tail = 0;  // head <= done <= wpos <= tail, [head, tail) in use
+  uint64_t written = 0;  // (writer thread only)
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::atomic<bool> stop{false};
+
+  std::atomic<uint64_t> num_frames{0}, num_dropped{0};
+  std::atomic<int> error{0};
+
+  bool header_sent = false;        // (writer thread only)
+  std::vector<struct iovec> iovs;  // (writer thread only)
+
+  std::thread thread;
+};
+
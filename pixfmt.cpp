@@ -0,0 +1,142 @@
+#include "pixfmt.h"
+#include <stdexcept>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+pixfmt_t pixfmt_of_visual(uint8_t depth, uint8_t bits_per_pixel,
+                          uint32_t red_mask, uint32_t green_mask, uint32_t blue_mask, bool msb_first)
+{
+  struct known_t {
+    PixelFormat format;
+    uint8_t depth, bits_per_pixel;
+    uint32_t red_mask, green_mask, blue_mask;
+  };
+  static const known_t known[] = {
+    { PixelFormat::BGRX, 24, 32, 0xff0000, 0x00ff00, 0x0000ff },  // --> NOTE: corresponds to BGRX in ndi
+    { PixelFormat::BGRA, 32, 32, 0xff0000, 0x00ff00, 0x0000ff },
+    { PixelFormat::RGBX, 24, 32, 0x0000ff, 0x00ff00, 0xff0000 },
+    { PixelFormat::RGB565, 16, 16, 0xf800, 0x07e0, 0x001f },
+    { PixelFormat::RGB30, 30, 32, 0x3ff00000, 0x000ffc00, 0x000003ff }
+  };
+  for (const known_t &k : known) {
+    if (k.depth == depth && k.bits_per_pixel == bits_per_pixel &&
+        k.red_mask == red_mask && k.green_mask == green_mask && k.blue_mask == blue_mask) {
+      return { k.format, msb_first };
+    }
+  }
+  throw std::runtime_error("Unsupported visualtype");
+}
+
+static inline uint32_t expand10(uint32_t c)
+{
+  return (c << 2) | (c >> 6);
+}
+
+static void pack_row_C(const pixfmt_t &fmt, const uint8_t *bgrx, uint8_t *dst, int n)
+{
+  const int bpp = fmt.bytes_per_pixel();
+  for (int x = 0; x < n; x++, bgrx += 4, dst += bpp) {
+    const uint32_t b = bgrx[0], g = bgrx[1], r = bgrx[2], a = bgrx[3];
+    uint32_t v;
+    switch (fmt.format) {
+    case PixelFormat::BGRX: v = (r << 16) | (g << 8) | b; break;
+    case PixelFormat::BGRA: v = (a << 24) | (r << 16) | (g << 8) | b; break;
+    case PixelFormat::RGBX: v = (b << 16) | (g << 8) | r; break;
+    case PixelFormat::RGB565: v = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3); break;
+    case PixelFormat::RGB30: v = (expand10(r) << 20) | (expand10(g) << 10) | expand10(b); break;
+    default: v = 0; break;
+    }
+    for (int i = 0; i < bpp; i++) { // (byte order of the image, not of the host)
+      dst[fmt.swapped ? bpp - 1 - i : i] = v >> (8 * i);
+    }
+  }
+}
+
+#ifdef __SSE2__
+// 4 pixels (as little-endian uint32 B G R X) -> 32 bit pixel values
+static inline __m128i pack32_SSE2(PixelFormat format, __m128i v)
+{
+  const __m128i m8 = _mm_set1_epi32(0xff);
+  switch (format) {
+  case PixelFormat::RGBX:
+    return _mm_or_si128(_mm_or_si128(
+      _mm_and_si128(v, _mm_set1_epi32(0x00ff00)),
+      _mm_and_si128(_mm_srli_epi32(v, 16), m8)),
+      _mm_slli_epi32(_mm_and_si128(v, m8), 16));
+  case PixelFormat::RGB30: {
+    const __m128i b = _mm_and_si128(v, m8),
+                  g = _mm_and_si128(_mm_srli_epi32(v, 8), m8),
+                  r = _mm_and_si128(_mm_srli_epi32(v, 16), m8);
+    const __m128i b10 = _mm_or_si128(_mm_slli_epi32(b, 2), _mm_srli_epi32(b, 6)),
+                  g10 = _mm_or_si128(_mm_slli_epi32(g, 2), _mm_srli_epi32(g, 6)),
+                  r10 = _mm_or_si128(_mm_slli_epi32(r, 2), _mm_srli_epi32(r, 6));
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r10, 20), _mm_slli_epi32(g10, 10)), b10);
+  }
+  case PixelFormat::RGB565: // (in the low 16 bits)
+    return _mm_or_si128(_mm_or_si128(
+      _mm_and_si128(_mm_srli_epi32(v, 8), _mm_set1_epi32(0xf800)),
+      _mm_and_si128(_mm_srli_epi32(v, 5), _mm_set1_epi32(0x07e0))),
+      _mm_and_si128(_mm_srli_epi32(v, 3), _mm_set1_epi32(0x001f)));
+  case PixelFormat::BGRA:
+    return v;
+  case PixelFormat::BGRX:
+  default:
+    return _mm_and_si128(v, _mm_set1_epi32(0xffffff));
+  }
+}
+
+static inline __m128i bswap16_SSE2(__m128i v)
+{
+  return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline __m128i bswap32_SSE2(__m128i v)
+{
+  v = bswap16_SSE2(v);
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+// 8 pixels per iteration (the format switch is hoisted by inlining into the per-format loops)
+template <PixelFormat format, bool swapped>
+static void pack_row_SSE2(const uint8_t *bgrx, uint8_t *dst, int n)
+{
+  int x = 0;
+  for (; x + 8 <= n; x += 8) {
+    const __m128i a = pack32_SSE2(format, _mm_loadu_si128((const __m128i *)(bgrx + 4 * x))),
+                  b = pack32_SSE2(format, _mm_loadu_si128((const __m128i *)(bgrx + 4 * x + 16)));
+    if (format == PixelFormat::RGB565) { // (sign-extend, so packs does not saturate)
+      __m128i v = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+      if (swapped) {
+        v = bswap16_SSE2(v);
+      }
+      _mm_storeu_si128((__m128i *)(dst + 2 * x), v);
+    } else {
+      _mm_storeu_si128((__m128i *)(dst + 4 * x), swapped ? bswap32_SSE2(a) : a);
+      _mm_storeu_si128((__m128i *)(dst + 4 * x + 16), swapped ? bswap32_SSE2(b) : b);
+    }
+  }
+  const pixfmt_t fmt = { format, swapped };
+  pack_row_C(fmt, bgrx + 4 * x, dst + fmt.bytes_per_pixel() * x, n - x);
+}
+#endif
+
+void pack_row(const pixfmt_t &fmt, const uint8_t *bgrx, uint8_t *dst, int n)
+{
+#ifdef __SSE2__
+  switch (fmt.format) {
+  case PixelFormat::BGRX:
+    return fmt.swapped ? pack_row_SSE2<PixelFormat::BGRX, true>(bgrx, dst, n) : pack_row_SSE2<PixelFormat::BGRX, false>(bgrx, dst, n);
+  case PixelFormat::BGRA:
+    return fmt.swapped ? pack_row_SSE2<PixelFormat::BGRA, true>(bgrx, dst, n) : pack_row_SSE2<PixelFormat::BGRA, false>(bgrx, dst, n);
+  case PixelFormat::RGBX:
+    return fmt.swapped ? pack_row_SSE2<PixelFormat::RGBX, true>(bgrx, dst, n) : pack_row_SSE2<PixelFormat::RGBX, false>(bgrx, dst, n);
+  case PixelFormat::RGB565:
+    return fmt.swapped ? pack_row_SSE2<PixelFormat::RGB565, true>(bgrx, dst, n) : pack_row_SSE2<PixelFormat::RGB565, false>(bgrx, dst, n);
+  case PixelFormat::RGB30:
+    return fmt.swapped ? pack_row_SSE2<PixelFormat::RGB30, true>(bgrx, dst, n) : pack_row_SSE2<PixelFormat::RGB30, false>(bgrx, dst, n);
+  }
+#else
+  pack_row_C(fmt, bgrx, dst, n);
+#endif
+}
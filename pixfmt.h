@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// X image formats the scaled BGRX rows are packed into (TrueColor, ZPixmap)
+enum class PixelFormat {
+  BGRX,     // depth 24, 32 bpp, red 0xff0000, green 0xff00, blue 0xff (native)
+  BGRA,     // depth 32, as BGRX, but with (premultiplied) alpha, i.e. ARGB visual for a compositing manager (native)
+  RGBX,     // depth 24, 32 bpp, red 0xff, green 0xff00, blue 0xff0000
+  RGB565,   // depth 16, 16 bpp, red 0xf800, green 0x07e0, blue 0x001f
+  RGB30     // depth 30, 32 bpp, red 0x3ff00000, green 0xffc00, blue 0x3ff (2:10:10:10)
+};
+
+struct pixfmt_t {
+  PixelFormat format;
+  bool swapped;  // image byte order is MSB first
+
+  bool native() const { return (format == PixelFormat::BGRX || format == PixelFormat::BGRA) && !swapped; }
+  int bytes_per_pixel() const { return (format == PixelFormat::RGB565) ? 2 : 4; }
+};
+
+// throws for unsupported visuals
+pixfmt_t pixfmt_of_visual(uint8_t depth, uint8_t bits_per_pixel,
+                          uint32_t red_mask, uint32_t green_mask, uint32_t blue_mask, bool msb_first);
+
+void pack_row(const pixfmt_t &fmt, const uint8_t *bgrx, uint8_t *dst, int n);
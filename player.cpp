@@ -0,0 +1,115 @@
+#include "player.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+RawPlayer::RawPlayer(const char *filename)
+{
+  fd = open(filename, O_RDONLY);
+  if (fd == -1) {
+    throw std::system_error(errno, std::generic_category(), std::string("Could not open ") + filename);
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    const int code = errno;
+    close(fd);
+    throw std::system_error(code, std::generic_category(), "fstat failed");
+  }
+  len = st.st_size;
+
+  if (len < sizeof(rawfile_header_t) + sizeof(rawfile_trailer_t)) {
+    close(fd);
+    throw std::runtime_error("Not a rawfile (too short)");
+  }
+
+  void *addr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    const int code = errno;
+    close(fd);
+    throw std::system_error(code, std::generic_category(), "mmap failed");
+  }
+  base = (const uint8_t *)addr;
+
+  // we manage readahead ourselves: the frames are much larger than the default window anyway
+  madvise(addr, len, MADV_RANDOM);
+
+  const rawfile_header_t *header = (const rawfile_header_t *)base;
+  const rawfile_trailer_t *trailer = (const rawfile_trailer_t *)(base + len - sizeof(rawfile_trailer_t));
+  if (header->magic != RAWFILE_MAGIC || header->version != RAWFILE_VERSION ||
+      trailer->magic != RAWFILE_MAGIC || trailer->version != RAWFILE_VERSION ||
+      trailer->index_offset > len - sizeof(rawfile_trailer_t) ||
+      trailer->num_frames > (len - sizeof(rawfile_trailer_t) - trailer->index_offset) / sizeof(rawfile_index_t)) {
+    munmap(addr, len);
+    close(fd);
+    throw std::runtime_error("Not a rawfile or missing index");
+  }
+  idx = (const rawfile_index_t *)(base + trailer->index_offset);
+  num_frames = trailer->num_frames;
+
+  for (size_t i = 0; i < num_frames; i++) {
+    const rawfile_index_t &f = idx[i];
+    const int bpp = rawfile_bytes_per_pixel(f.fourcc);  // (unknown fourcc: not shown, stride not checked)
+    if (f.offset > trailer->index_offset || f.size > trailer->index_offset - f.offset ||
+        f.xres <= 0 || f.yres <= 0 || f.stride <= 0 || (int64_t)f.stride < (int64_t)f.xres * bpp ||
+        f.size < rawfile_frame_size(f.fourcc, f.xres, f.yres, f.stride)) {
+      munmap(addr, len);
+      close(fd);
+      throw std::runtime_error("Corrupt rawfile index");
+    }
+  }
+  madvise((void *)((uintptr_t)idx & ~(uintptr_t)(RAWFILE_ALIGN - 1)), base + len - (const uint8_t *)idx, MADV_WILLNEED);
+}
+
+RawPlayer::~RawPlayer()
+{
+  munmap((void *)base, len);
+  close(fd);
+}
+
+// NOTE: frames start page-aligned (RAWFILE_ALIGN)
+void RawPlayer::advise(size_t first, size_t last, int advice)
+{
+  if (first >= last) {
+    return;
+  }
+  const uint8_t *start = base + idx[first].offset;
+  const uint8_t *end = base + idx[last - 1].offset + idx[last - 1].size;
+  madvise((void *)start, end - start, advice);
+}
+
+void RawPlayer::drop(size_t first, size_t last)
+{
+  if (first >= last) {
+    return;
+  }
+  advise(first, last, MADV_DONTNEED);  // only unmaps...
+  const off_t start = idx[first].offset;
+  posix_fadvise(fd, start, idx[last - 1].offset + idx[last - 1].size - start, POSIX_FADV_DONTNEED);  // ... this evicts from page cache
+}
+
+const uint8_t *RawPlayer::data(size_t pos)
+{
+  // assert(pos < num_frames);
+  const size_t ra_end = std::min(pos + 1 + readahead, num_frames);
+  if (last_pos != (size_t)-1 && pos == last_pos + 1) { // sequential: extend window by one, drop what is behind
+    if (ra_end > pos + 1) {
+      advise(ra_end - 1, ra_end, MADV_WILLNEED);
+    }
+    if (pos > readahead) {
+      drop(pos - readahead - 1, pos - readahead);
+    }
+  } else if (pos != last_pos) { // seek
+    advise(pos, ra_end, MADV_WILLNEED);
+  }
+  last_pos = pos;
+
+  return base + idx[pos].offset;
+}
+
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "rawfile.h"
+#include <stddef.h>
+
+// Read-only mmap of a rawfile (see rawfile.h), random access via the frame index.
+class RawPlayer {
+public:
+  RawPlayer(const char *filename);
+  ~RawPlayer();
+
+  RawPlayer(const RawPlayer &) = delete;
+  RawPlayer &operator=(const RawPlayer &) = delete;
+
+  size_t size() const {
+    return num_frames;
+  }
+
+  const rawfile_index_t &index(size_t pos) const {
+    // assert(pos < num_frames);
+    return idx[pos];
+  }
+
+  // also updates the readahead window around pos (forward: WILLNEED, behind: drop from page cache)
+  const uint8_t *data(size_t pos);
+
+  static constexpr size_t readahead = 8;  // frames
+
+private:
+  void advise(size_t first, size_t last, int advice);  // [first, last)
+  void drop(size_t first, size_t last);
+
+  int fd;
+  const uint8_t *base;
+  size_t len;
+
+  const rawfile_index_t *idx;
+  size_t num_frames;
+
+  size_t last_pos = (size_t)-1;
+};
+
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+// Simple indexed container for received frames (native endian, not meant for exchange):
+//   rawfile_header_t, padded to RAWFILE_ALIGN
+//   frame data, each frame starts at a RAWFILE_ALIGN-aligned offset (-> O_DIRECT)
+//   rawfile_index_t[num_frames]
+//   padding, rawfile_trailer_t at the very end of the file (file size is a multiple of RAWFILE_ALIGN)
+// A file without valid trailer (e.g. recorder was killed) has no index and cannot be played back (TODO? rebuild index by scanning).
+
+#define RAWFILE_ALIGN    4096
+#define RAWFILE_MAGIC    0x46525658  // "XVRF"
+#define RAWFILE_VERSION  1
+
+struct rawfile_header_t {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t align;
+  uint32_t reserved;
+};
+
+struct rawfile_index_t {
+  uint64_t offset;     // of frame data
+  uint64_t size;       // in bytes (w/o padding)
+  uint32_t fourcc;     // as NDIlib_FourCC_video_type_e
+  int32_t xres, yres;
+  int32_t stride;      // line_stride_in_bytes
+  int32_t frame_rate_N, frame_rate_D;
+  int32_t frame_format_type;
+  float picture_aspect_ratio;
+  int64_t timecode, timestamp;   // 100ns units
+};
+
+struct rawfile_trailer_t {
+  uint64_t index_offset;
+  uint64_t num_frames;
+  uint32_t magic;
+  uint32_t version;
+};
+
+// (FourCC values as in NDIlib_FourCC_video_type_e)
+// bytes per pixel in the first plane, 0: unknown fourcc
+static inline int rawfile_bytes_per_pixel(uint32_t fourcc)
+{
+  switch (fourcc) {
+  case 0x59565955: // 'UYVY'
+  case 0x41565955: // 'UYVA'
+  case 0x36313250: // 'P216'
+  case 0x36314150: // 'PA16'
+    return 2;
+  case 0x41524742: // 'BGRA'
+  case 0x58524742: // 'BGRX'
+    return 4;
+  }
+  return 0;
+}
+
+// frame data size as recorded: stride * yres per plane, UYVA + an xres * yres alpha plane, P216 2 planes, PA16 3
+static inline uint64_t rawfile_frame_size(uint32_t fourcc, int32_t xres, int32_t yres, int32_t stride)
+{
+  const uint64_t plane = (uint64_t)stride * yres;
+  switch (fourcc) {
+  case 0x41565955: return plane + (uint64_t)xres * yres;  // 'UYVA'
+  case 0x36313250: return 2 * plane;                      // 'P216'
+  case 0x36314150: return 3 * plane;                      // 'PA16'
+  }
+  return plane;
+}
+
@@ -0,0 +1,194 @@
+#include "recorder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <system_error>
+
+// TODO? io_uring (would need liburing); a single writer thread with O_DIRECT already keeps up with the network.
+
+static size_t align_up(size_t len)
+{
+  return (len + RAWFILE_ALIGN - 1) & ~(size_t)(RAWFILE_ALIGN - 1);
+}
+
+static uint8_t *alloc_aligned(size_t len)
+{
+  void *ret;
+  if (posix_memalign(&ret, RAWFILE_ALIGN, len) != 0) {
+    throw std::bad_alloc();
+  }
+  return (uint8_t *)ret;
+}
+
+Recorder::Recorder(const char *filename, size_t num_buffers)
+  : pool(num_buffers)
+{
+  fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+  direct = (fd != -1);
+  if (fd == -1 && errno == EINVAL) { // e.g. tmpfs
+    fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if (fd == -1) {
+    throw std::system_error(errno, std::generic_category(), std::string("Could not open ") + filename);
+  }
+
+  free_list.reserve(num_buffers);
+  for (size_t i = 0; i < num_buffers; i++) {
+    free_list.push_back(i);
+  }
+  queue.resize(num_buffers);
+  index.reserve(1024);
+
+  uint8_t *hdr = alloc_aligned(RAWFILE_ALIGN);
+  memset(hdr, 0, RAWFILE_ALIGN);
+  const rawfile_header_t header = { RAWFILE_MAGIC, RAWFILE_VERSION, RAWFILE_ALIGN, 0 };
+  memcpy(hdr, &header, sizeof(header));
+  const bool res = write_aligned(hdr, RAWFILE_ALIGN);
+  free(hdr);
+  if (!res) {
+    const int code = error;
+    ::close(fd);
+    throw std::system_error(code, std::generic_category(), "Could not write rawfile header");
+  }
+
+  thread = std::thread(&Recorder::writer, this);
+}
+
+Recorder::~Recorder()
+{
+  close();
+
+  for (buffer_t &buf : pool) {
+    free(buf.data);
+  }
+}
+
+void Recorder::close()
+{
+  if (fd == -1) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stop = true;
+  }
+  cv.notify_one();
+  thread.join();
+
+  finish();
+  ::close(fd);
+  fd = -1;
+}
+
+bool Recorder::push(const uint8_t *data, const rawfile_index_t &idx)
+{
+  size_t slot;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (free_list.empty() || error || stop) {
+      num_dropped++;
+      return false;
+    }
+    slot = free_list.back();
+    free_list.pop_back();
+  }
+
+  buffer_t &buf = pool[slot];
+  const size_t len = align_up(idx.size);
+  if (buf.capacity < len) { // only on format change
+    free(buf.data);
+    buf.data = nullptr;
+    buf.capacity = 0;  // (in case alloc_aligned throws)
+    buf.data = alloc_aligned(len);
+    buf.capacity = len;
+  }
+  memcpy(buf.data, data, idx.size);
+  memset(buf.data + idx.size, 0, len - idx.size);
+  buf.idx = idx;
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    queue[(queue_head + queue_len) % queue.size()] = slot;
+    queue_len++;
+  }
+  cv.notify_one();
+  return true;
+}
+
+void Recorder::writer()
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  while (true) {
+    cv.wait(lock, [this]() { return queue_len > 0 || stop; });
+    if (!queue_len) { // assert(stop);
+      break;
+    }
+    const size_t slot = queue[queue_head];
+    queue_head = (queue_head + 1) % queue.size();
+    queue_len--;
+    lock.unlock();
+
+    buffer_t &buf = pool[slot];
+    if (!error) {
+      buf.idx.offset = pos;
+      if (write_aligned(buf.data, align_up(buf.idx.size))) {
+        index.push_back(buf.idx);
+        num_written++;
+      } else {
+        num_dropped++;
+      }
+    } else {
+      num_dropped++;
+    }
+
+    lock.lock();
+    free_list.push_back(slot);
+  }
+}
+
+bool Recorder::write_aligned(const uint8_t *data, size_t len)
+{
+  while (len > 0) {
+    const ssize_t res = write(fd, data, len);
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EINVAL && direct) { // filesystem does not like O_DIRECT after all
+        direct = false;
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+        continue;
+      }
+      error = errno;
+      return false;
+    }
+    data += res;
+    len -= res;
+    pos += res;
+  }
+  return true;
+}
+
+void Recorder::finish()
+{
+  if (error) {
+    return;
+  }
+
+  const size_t index_len = index.size() * sizeof(rawfile_index_t);
+  const size_t len = align_up(index_len + sizeof(rawfile_trailer_t));
+  uint8_t *buf = alloc_aligned(len);
+  memset(buf, 0, len);
+  if (index_len) {
+    memcpy(buf, index.data(), index_len);
+  }
+  const rawfile_trailer_t trailer = { pos, index.size(), RAWFILE_MAGIC, RAWFILE_VERSION };
+  memcpy(buf + len - sizeof(trailer), &trailer, sizeof(trailer));
+
+  write_aligned(buf, len);
+  free(buf);
+}
+
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "rawfile.h"
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Writes received frames untouched into a rawfile (see rawfile.h).
+// push() copies into one of a fixed pool of aligned buffers and never waits for the disk:
+// when all buffers are still queued for writing, the frame is dropped (and counted).
+class Recorder {
+public:
+  Recorder(const char *filename, size_t num_buffers = 8);
+  ~Recorder();
+
+  // writes remaining frames + index (also done by dtor)
+  void close();
+
+  Recorder(const Recorder &) = delete;
+  Recorder &operator=(const Recorder &) = delete;
+
+  // NOTE: idx.offset is filled in by the writer
+  // returns false, when frame was dropped
+  bool push(const uint8_t *data, const rawfile_index_t &idx);
+
+  uint64_t frames() const { return num_written; }
+  uint64_t dropped() const { return num_dropped; }
+  bool failed() const { return error != 0; }
+
+private:
+  struct buffer_t {
+    uint8_t *data = nullptr;
+    size_t capacity = 0;
+    rawfile_index_t idx;
+  };
+
+  void writer();
+  bool write_aligned(const uint8_t *data, size_t len); // len: multiple of RAWFILE_ALIGN
+  void finish();
+
+  int fd;  // -1 after close()
+  bool direct;  // O_DIRECT active
+  uint64_t pos = 0;
+
+  std::vector<buffer_t> pool;
+  std::vector<size_t> free_list;   // NOTE: free_list and queue never exceed pool.size() -> reserved, no allocations
+  std::vector<size_t> queue;       // FIFO ring
+  size_t queue_head = 0, queue_len = 0;
+  std::vector<rawfile_index_t> index;   // (writer thread only)
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool stop = false;
+
+  std::atomic<uint64_t> num_written{0}, num_dropped{0};
+  std::atomic<int> error{0};
+
+  std::thread thread;
+};
+
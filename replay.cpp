@@ -0,0 +1,57 @@
+#include "replay.h"
+#include "libyuv/convert_argb.h"
+#include "libyuv/convert_from_argb.h"
+#include <algorithm>
+#include <assert.h>
+
+void ReplayRing::reset(int _xres, int _yres, int _fps_n, int _fps_d)
+{
+  xres = _xres;
+  yres = _yres;
+  fps_n = _fps_n;
+  fps_d = _fps_d;
+
+  uyvy_stride = ((size_t)(xres + 1) / 2 * 4 + 31) & ~31;
+  bgra_stride = (size_t)xres * 4;
+
+  // unknown frame rate: assume 60 fps
+  const unsigned int fps = (fps_n > 0 && fps_d > 0) ? (fps_n + fps_d - 1) / fps_d : 60;
+  capacity = std::max<size_t>(seconds * fps, 1);
+  count = 0;
+
+  // NOTE: no shrink_to_fit(), a smaller format will reuse the existing allocation
+  arena.resize(capacity * uyvy_stride * yres);
+  fields.resize(capacity);
+  scratch.resize(bgra_stride * yres);
+}
+
+void ReplayRing::push(const uint8_t *bgra, int stride, int _xres, int _yres, field_t field, int _fps_n, int _fps_d)
+{
+  if (_xres != xres || _yres != yres || _fps_n != fps_n || _fps_d != fps_d) {
+    reset(_xres, _yres, _fps_n, _fps_d);
+  }
+
+  uint8_t *dst = arena.data() + (count % capacity) * uyvy_stride * yres;
+  const int res = libyuv::ARGBToUYVY(
+    bgra, stride,
+    dst, uyvy_stride,
+    xres, yres);
+  assert(res == 0);
+  fields[count % capacity] = field;
+  count++;
+}
+
+ReplayRing::frame_t ReplayRing::convert(uint64_t seq)
+{
+  // assert(!empty() && seq >= first() && seq <= last());
+  const uint8_t *src = arena.data() + (seq % capacity) * uyvy_stride * yres;
+  const int res = libyuv::UYVYToARGBMatrix(
+    src, uyvy_stride,
+    scratch.data(), bgra_stride,
+    &libyuv::kYuvI601Constants,  // (matches ARGBToUYVY)
+    xres, yres);
+  assert(res == 0);
+
+  return { scratch.data(), (int)bgra_stride, xres, yres, fields[seq % capacity] };
+}
+
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "deinterlace.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Keeps the last N seconds of received frames, stored as UYVY (half the size of BGRA), with their field type
+// (single fields stay fields: they are deinterlaced when shown, like live ones).
+// The arena is only (re)allocated when the stream format changes, i.e. steady state never allocates.
+// NOTE: alpha is not retained.
+class ReplayRing {
+public:
+  ReplayRing(unsigned int seconds) : seconds(seconds) { }
+
+  // NOTE: frame rate is only used to size the arena
+  void push(const uint8_t *bgra, int stride, int xres, int yres, field_t field, int fps_n, int fps_d);
+
+  // frames are addressed by absolute sequence number: [first(), last()]
+  uint64_t first() const {
+    return (count > capacity) ? count - capacity : 0;
+  }
+  uint64_t last() const { // only valid when !empty()
+    return count - 1;
+  }
+  bool empty() const {
+    return count == 0;
+  }
+
+  struct frame_t {
+    const uint8_t *data;
+    int stride, xres, yres;
+    field_t field;
+  };
+
+  // converts (only) the requested frame to BGRX; result stays valid until the next convert()/push() with a different format
+  frame_t convert(uint64_t seq);
+
+private:
+  void reset(int xres, int yres, int fps_n, int fps_d);
+
+  unsigned int seconds;
+
+  int xres = 0, yres = 0, fps_n = 0, fps_d = 0;
+  size_t uyvy_stride = 0, bgra_stride = 0;
+  size_t capacity = 0;    // in frames
+  uint64_t count = 0;     // total frames pushed (since last reset)
+
+  std::vector<uint8_t> arena;
+  std::vector<field_t> fields;   // (per slot)
+  std::vector<uint8_t> scratch;  // single BGRX frame for display
+};
+
@@ -0,0 +1,296 @@
+#include "scopes.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define SCOPE_SAMPLES_X  512
+#define SCOPE_SAMPLES_Y  288
+#define WAVEFORM_COLS    256
+#define PARADE_COLS      128   // per component
+
+void Scopes::set_mode(ScopeMode val)
+{
+  cur_mode = val;
+  valid = false;
+}
+
+void Scopes::next_mode()
+{
+  set_mode((cur_mode == ScopeMode::HISTOGRAM) ? ScopeMode::OFF : (ScopeMode)((int)cur_mode + 1));
+}
+
+size_t Scopes::acc_size() const
+{
+  switch (cur_mode) {
+  case ScopeMode::WAVEFORM: return WAVEFORM_COLS * 256;
+  case ScopeMode::PARADE: return 3 * PARADE_COLS * 256;
+  case ScopeMode::VECTORSCOPE: return 256 * 256;
+  case ScopeMode::HISTOGRAM: return 4 * 256;  // Y, R, G, B
+  default: return 0;
+  }
+}
+
+// BT.709, 8 bit fixed point
+#define KR  54
+#define KG  183
+#define KB  19
+
+static void convert_row_C(const uint32_t *bgra, int n, uint8_t *y, uint8_t *cb, uint8_t *cr)
+{
+  for (int i = 0; i < n; i++) {
+    const int b = bgra[i] & 0xff, g = (bgra[i] >> 8) & 0xff, r = (bgra[i] >> 16) & 0xff;
+    y[i] = (KR * r + KG * g + KB * b + 128) >> 8;
+    cb[i] = std::min((-29 * r - 99 * g + 128 * b + 128 * 256 + 128) >> 8, 255);
+    cr[i] = std::min((128 * r - 116 * g - 12 * b + 128 * 256 + 128) >> 8, 255);
+  }
+}
+
+#ifdef __SSE2__
+// 4 pixels at a time: 16 bit lanes, pmaddwd does two products per 32 bit lane
+static inline __m128i dot4(__m128i lo, __m128i hi, __m128i coef)
+{
+  // lo/hi: 2 pixels each as (b, g, r, a) 16 bit -> (b*kb + g*kg, r*kr + a*0) x 2
+  const __m128i plo = _mm_madd_epi16(lo, coef),
+                phi = _mm_madd_epi16(hi, coef);
+  // horizontal add of adjacent 32 bit lanes
+  const __m128i sum_lo = _mm_add_epi32(plo, _mm_srli_epi64(plo, 32)),
+                sum_hi = _mm_add_epi32(phi, _mm_srli_epi64(phi, 32));
+  return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(sum_lo), _mm_castsi128_ps(sum_hi), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+static void convert_row_SSE2(const uint32_t *bgra, int n, uint8_t *y, uint8_t *cb, uint8_t *cr)
+{
+  const __m128i zero = _mm_setzero_si128(),
+                round = _mm_set1_epi32(128),
+                bias = _mm_set1_epi32(128 * 256 + 128);
+  const __m128i ky = _mm_set_epi16(0, KR, KG, KB, 0, KR, KG, KB),
+                ku = _mm_set_epi16(0, -29, -99, 128, 0, -29, -99, 128),
+                kv = _mm_set_epi16(0, 128, -116, -12, 0, 128, -116, -12);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128i px = _mm_loadu_si128((const __m128i *)(bgra + i)),
+                  lo = _mm_unpacklo_epi8(px, zero),
+                  hi = _mm_unpackhi_epi8(px, zero);
+    const __m128i vy = _mm_srai_epi32(_mm_add_epi32(dot4(lo, hi, ky), round), 8),
+                  vu = _mm_srai_epi32(_mm_add_epi32(dot4(lo, hi, ku), bias), 8),
+                  vv = _mm_srai_epi32(_mm_add_epi32(dot4(lo, hi, kv), bias), 8);
+    // 32 -> 8 bit (saturating: 0..256)
+    const __m128i yu = _mm_packs_epi32(vy, vu),
+                  vx = _mm_packs_epi32(vv, vv),
+                  p8 = _mm_packus_epi16(yu, vx);
+    uint32_t out[4];
+    _mm_storeu_si128((__m128i *)out, p8);
+    memcpy(y + i, &out[0], 4);
+    memcpy(cb + i, &out[1], 4);
+    memcpy(cr + i, &out[2], 4);
+  }
+  convert_row_C(bgra + i, n - i, y + i, cb + i, cr + i);
+}
+#endif
+
+void scope_convert_row(const uint32_t *bgra, int n, uint8_t *y, uint8_t *cb, uint8_t *cr)
+{
+#ifdef __SSE2__
+  convert_row_SSE2(bgra, n, y, cb, cr);
+#else
+  convert_row_C(bgra, n, y, cb, cr);
+#endif
+}
+
+void Scopes::analyze(const uint8_t *bgra, int stride, int xres, int yres, field_t field)
+{
+  if (cur_mode == ScopeMode::OFF || xres <= 0 || yres <= 0) {
+    return;
+  }
+  const int rows = yres;
+  yres = Deinterlacer::frame_height(field, rows);  // (sample grid: as for the progressive frame)
+
+  const int step_x = (xres + SCOPE_SAMPLES_X - 1) / SCOPE_SAMPLES_X,
+            step_y = (yres + SCOPE_SAMPLES_Y - 1) / SCOPE_SAMPLES_Y,
+            nx = (xres + step_x - 1) / step_x,
+            ny = (yres + step_y - 1) / step_y,
+            bands = std::min<int>(pool.size(), ny);
+  const size_t size = acc_size();
+  partial.resize(bands);
+
+  pool.run(bands, [&](int band) {
+    std::vector<uint32_t> &acc = partial[band];
+    acc.assign(size, 0);
+
+    static thread_local std::vector<uint32_t> px;
+    static thread_local std::vector<uint8_t> comp;
+    px.resize(nx);
+    comp.resize(3 * nx);
+    uint8_t *y = comp.data(), *cb = y + nx, *cr = cb + nx;
+
+    for (int row = band * ny / bands; row < (band + 1) * ny / bands; row++) {
+      const uint32_t *src = (const uint32_t *)(bgra + (size_t)(row * step_y * rows / yres) * stride);
+      for (int i = 0; i < nx; i++) {
+        px[i] = src[i * step_x];
+      }
+      scope_convert_row(px.data(), nx, y, cb, cr);
+
+      switch (cur_mode) {
+      case ScopeMode::WAVEFORM:
+        for (int i = 0; i < nx; i++) {
+          acc[(i * WAVEFORM_COLS / nx) * 256 + y[i]]++;
+        }
+        break;
+      case ScopeMode::PARADE:
+        for (int i = 0; i < nx; i++) {
+          const int col = i * PARADE_COLS / nx;
+          acc[(0 * PARADE_COLS + col) * 256 + ((px[i] >> 16) & 0xff)]++;
+          acc[(1 * PARADE_COLS + col) * 256 + ((px[i] >> 8) & 0xff)]++;
+          acc[(2 * PARADE_COLS + col) * 256 + (px[i] & 0xff)]++;
+        }
+        break;
+      case ScopeMode::VECTORSCOPE:
+        for (int i = 0; i < nx; i++) {
+          acc[cr[i] * 256 + cb[i]]++;
+        }
+        break;
+      case ScopeMode::HISTOGRAM:
+        for (int i = 0; i < nx; i++) {
+          acc[y[i]]++;
+          acc[256 + ((px[i] >> 16) & 0xff)]++;
+          acc[512 + ((px[i] >> 8) & 0xff)]++;
+          acc[768 + (px[i] & 0xff)]++;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  });
+
+  acc.swap(partial[0]);
+  for (int band = 1; band < bands; band++) {
+    const uint32_t *src = partial[band].data();
+    for (size_t i = 0; i < size; i++) {  // (vectorized by the compiler)
+      acc[i] += src[i];
+    }
+  }
+  acc_max = *std::max_element(acc.begin(), acc.end());
+  valid = true;
+}
+
+static inline void darken(uint8_t *px)  // (opaque, also on an ARGB visual)
+{
+  px[0] >>= 2;
+  px[1] >>= 2;
+  px[2] >>= 2;
+  px[3] = 0xff;
+}
+
+void Scopes::draw(uint8_t *bgrx, int stride, int width, int height, int y0, int rows) const
+{
+  if (cur_mode == ScopeMode::OFF || !valid) {
+    return;
+  }
+  const int margin = 8;
+  int pw = width / 3, ph = height / 3;
+  if (cur_mode == ScopeMode::VECTORSCOPE) {
+    pw = ph = std::min(pw, ph);
+  }
+  if (pw < 64 || ph < 48) {
+    return;
+  }
+
+  const int top = height - margin - ph,
+            py0 = std::max(y0 - top, 0), py1 = std::min(y0 + rows - top, ph);  // (visible panel rows)
+  if (py0 >= py1) {
+    return;
+  }
+  uint8_t *panel = bgrx + (ptrdiff_t)(top + py0 - y0) * stride + margin * 4;
+  if (cur_mode == ScopeMode::HISTOGRAM) {
+    draw_histogram(panel, stride, pw, ph, py0, py1);
+  } else {
+    draw_density(panel, stride, pw, ph, py0, py1);
+  }
+}
+
+void Scopes::draw_density(uint8_t *panel, int stride, int pw, int ph, int py0, int py1) const
+{
+  const float norm = 1.0f / (acc_max ? acc_max : 1);
+  for (int py = py0; py < py1; py++) {
+    uint8_t *row = panel + (size_t)(py - py0) * stride;
+    const int v = 255 - py * 256 / ph;
+    const bool grid = (cur_mode != ScopeMode::VECTORSCOPE) && ((py * 4) % ph < 4);  // 0, 25, 50, 75 %
+    for (int px = 0; px < pw; px++) {
+      uint8_t *out = row + px * 4;
+      darken(out);
+
+      uint32_t count;
+      int tint = -1;  // -1: white/green, else: 2 = R, 1 = G, 0 = B (byte in BGRX)
+      switch (cur_mode) {
+      case ScopeMode::WAVEFORM:
+        count = acc[(px * WAVEFORM_COLS / pw) * 256 + v];
+        break;
+      case ScopeMode::PARADE: {
+        const int part = px * 3 / pw,
+                  col = std::min((px - part * pw / 3) * PARADE_COLS * 3 / pw, PARADE_COLS - 1);
+        count = acc[(part * PARADE_COLS + col) * 256 + v];
+        tint = 2 - part;
+        break;
+      }
+      case ScopeMode::VECTORSCOPE:
+        count = acc[v * 256 + px * 256 / pw];
+        if (px == pw / 2 || py == ph / 2) {
+          out[0] = out[1] = out[2] = 0x40;
+        }
+        break;
+      default:
+        count = 0;
+        break;
+      }
+      if (grid) {
+        out[0] = out[1] = out[2] = 0x40;
+      }
+      if (!count) {
+        continue;
+      }
+
+      const int i = 64 + (int)(191 * sqrtf(count * norm));
+      if (tint < 0) {
+        out[0] = i / 2;
+        out[1] = i;
+        out[2] = i / 2;
+      } else {
+        out[tint] = i;
+      }
+    }
+  }
+}
+
+void Scopes::draw_histogram(uint8_t *panel, int stride, int pw, int ph, int py0, int py1) const
+{
+  uint32_t max[4] = {};
+  for (int c = 0; c < 4; c++) {
+    max[c] = *std::max_element(acc.begin() + c * 256, acc.begin() + (c + 1) * 256);
+    if (!max[c]) {
+      max[c] = 1;
+    }
+  }
+
+  for (int px = 0; px < pw; px++) {
+    const int bin = px * 256 / pw;
+    int h[4];
+    for (int c = 0; c < 4; c++) {
+      h[c] = (int)((uint64_t)acc[c * 256 + bin] * ph / max[c]);
+    }
+    for (int py = py0; py < py1; py++) {
+      uint8_t *out = panel + (size_t)(py - py0) * stride + px * 4;
+      darken(out);
+      const int level = ph - py;  // from bottom
+      if (level <= h[0]) { // Y
+        out[0] = out[1] = out[2] = 0x60;
+      }
+      if (level <= h[1]) out[2] = 0xe0;  // R
+      if (level <= h[2]) out[1] = 0xe0;  // G
+      if (level <= h[3]) out[0] = 0xe0;  // B
+    }
+  }
+}
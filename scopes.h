@@ -0,0 +1,43 @@
+#pragma once
+
+#include "deinterlace.h"
+#include "workers.h"
+#include <stdint.h>
+#include <vector>
+
+enum class ScopeMode { OFF, WAVEFORM, PARADE, VECTORSCOPE, HISTOGRAM };
+
+// Waveform (luma), RGB parade, vectorscope (BT.709 Cb/Cr) and histogram of the received BGRA frame.
+// analyze() looks only at a strided subsample (at most SCOPE_SAMPLES_X * SCOPE_SAMPLES_Y pixels), in row bands across the pool;
+// draw() renders the result as a panel into the bottom left of the output image (or the part of it within the given rows).
+class Scopes {
+public:
+  explicit Scopes(WorkerPool &pool) : pool(pool) { }
+
+  void set_mode(ScopeMode val);
+  ScopeMode mode() const { return cur_mode; }
+  void next_mode();  // ... -> OFF -> WAVEFORM -> ...
+
+  // single fields (yres: field height) are sampled as the frame they are shown as (line-doubled)
+  void analyze(const uint8_t *bgra, int stride, int xres, int yres, field_t field = FIELD_NONE);
+
+  // only rows [y0, y0 + rows) of the width x height image are touched, bgrx points at row y0
+  void draw(uint8_t *bgrx, int stride, int width, int height, int y0, int rows) const;
+
+private:
+  size_t acc_size() const;
+  // panel points at panel row py0
+  void draw_density(uint8_t *panel, int stride, int pw, int ph, int py0, int py1) const;
+  void draw_histogram(uint8_t *panel, int stride, int pw, int ph, int py0, int py1) const;
+
+  WorkerPool &pool;
+  ScopeMode cur_mode = ScopeMode::OFF;
+
+  std::vector<std::vector<uint32_t>> partial;  // per band
+  std::vector<uint32_t> acc;                   // (merged)
+  uint32_t acc_max = 0;
+  bool valid = false;
+};
+
+// BGRA -> BT.709 Y'CbCr (full range), n pixels
+void scope_convert_row(const uint32_t *bgra, int n, uint8_t *y, uint8_t *cb, uint8_t *cr);
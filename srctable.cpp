@@ -0,0 +1,164 @@
+#include "srctable.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+static std::string shm_name()
+{
+  return "/xndiview-sources-" + std::to_string(getuid());
+}
+
+static bool daemon_alive(pid_t pid)
+{
+  return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+SourceTableWriter::SourceTableWriter()
+{
+  const std::string name = shm_name();
+  const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd == -1) {
+    throw std::system_error(errno, std::generic_category(), "shm_open failed");
+  }
+  if (ftruncate(fd, sizeof(srctable_t)) == -1) {
+    const int code = errno;
+    close(fd);
+    throw std::system_error(code, std::generic_category(), "ftruncate failed");
+  }
+  void *addr = mmap(NULL, sizeof(srctable_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    throw std::system_error(errno, std::generic_category(), "mmap failed");
+  }
+  table = (srctable_t *)addr;
+
+  if (table->magic == SRCTABLE_MAGIC && daemon_alive(table->pid) && table->pid != getpid()) {
+    munmap(addr, sizeof(srctable_t));
+    throw std::runtime_error("Discovery daemon already running");  // TODO? race between two starting daemons
+  }
+
+  // (readers check magic/version only once: keep seq counting, if the segment was left over)
+  const uint32_t seq = (table->magic == SRCTABLE_MAGIC) ? table->seq.load(std::memory_order_relaxed) : 0;
+  table->seq.store(seq | 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  table->num = 0;
+  table->pid = getpid();
+  table->version = SRCTABLE_VERSION;
+  table->magic = SRCTABLE_MAGIC;
+  table->seq.store((seq | 1) + 1, std::memory_order_release);
+}
+
+SourceTableWriter::~SourceTableWriter()
+{
+  table->pid = 0;
+  munmap(table, sizeof(srctable_t));
+  shm_unlink(shm_name().c_str());
+}
+
+void SourceTableWriter::publish(const source_list_t &sources)
+{
+  const uint32_t seq = table->seq.load(std::memory_order_relaxed);
+  table->seq.store(seq + 1, std::memory_order_relaxed);  // odd: update in progress
+  std::atomic_thread_fence(std::memory_order_release);
+
+  uint32_t num = 0;
+  for (const auto &src : sources) {
+    if (num >= SRCTABLE_MAX) {
+      break;
+    }
+    if (src.first.size() >= SRCTABLE_NAME_LEN || src.second.size() >= SRCTABLE_URL_LEN) {
+      continue;
+    }
+    srctable_entry_t &e = table->entries[num++];
+    memcpy(e.name, src.first.c_str(), src.first.size() + 1);
+    memcpy(e.url, src.second.c_str(), src.second.size() + 1);
+  }
+  table->num = num;
+
+  table->seq.store(seq + 2, std::memory_order_release);
+}
+
+
+bool SourceTableReader::open()
+{
+  const int fd = shm_open(shm_name().c_str(), O_RDONLY, 0);
+  if (fd == -1) {
+    return false;
+  }
+  void *addr = mmap(NULL, sizeof(srctable_t), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  table = (const srctable_t *)addr;
+
+  if (table->magic != SRCTABLE_MAGIC || table->version != SRCTABLE_VERSION || !daemon_alive(table->pid)) {
+    munmap(addr, sizeof(srctable_t));
+    table = nullptr;
+    return false;
+  }
+  last_seq = table->seq.load(std::memory_order_acquire) - 2;  // (first changed() reports the current table)
+  return true;
+}
+
+SourceTableReader::~SourceTableReader()
+{
+  if (table) {
+    munmap((void *)table, sizeof(srctable_t));
+  }
+}
+
+bool SourceTableReader::snapshot(source_list_t &ret)
+{
+  if (!table || !daemon_alive(table->pid)) {
+    return false;
+  }
+
+  static thread_local srctable_entry_t buf[SRCTABLE_MAX];  // (~80 KiB, not on the stack)
+  uint32_t seq, num;
+  do {
+    while ((seq = table->seq.load(std::memory_order_acquire)) & 1) {  // (writer is quick)
+      if (!daemon_alive(table->pid)) { // ... unless it crashed during the update
+        return false;
+      }
+      sched_yield();
+    }
+    num = std::min<uint32_t>(table->num, SRCTABLE_MAX);
+    memcpy(buf, (const void *)table->entries, num * sizeof(srctable_entry_t));
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while (table->seq.load(std::memory_order_relaxed) != seq);
+  last_seq = seq;
+
+  ret.clear();
+  for (uint32_t i = 0; i < num; i++) {
+    ret.emplace_back(std::string(buf[i].name, strnlen(buf[i].name, SRCTABLE_NAME_LEN)),
+                     std::string(buf[i].url, strnlen(buf[i].url, SRCTABLE_URL_LEN)));
+  }
+  return true;
+}
+
+bool SourceTableReader::changed()
+{
+  return table && table->seq.load(std::memory_order_acquire) != last_seq;
+}
+
+std::string SourceTableReader::lookup(const std::string &name)
+{
+  source_list_t list;
+  if (snapshot(list)) {
+    for (const auto &e : list) {
+      if (e.first == name) {
+        return e.second;
+      }
+    }
+  }
+  return {};
+}
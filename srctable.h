@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Source table published by the discovery daemon (-D) in POSIX shm "/xndiview-sources-<uid>".
+// Single writer, any number of lock-free readers (seqlock: seq is odd while an update is in progress).
+
+#define SRCTABLE_MAGIC    0x54535658  // 'XVST'
+#define SRCTABLE_VERSION  1
+#define SRCTABLE_MAX      256
+#define SRCTABLE_NAME_LEN 256
+#define SRCTABLE_URL_LEN  64
+
+struct srctable_entry_t {
+  char name[SRCTABLE_NAME_LEN];
+  char url[SRCTABLE_URL_LEN];
+};
+
+struct srctable_t {
+  uint32_t magic, version;
+  std::atomic<uint32_t> seq;
+  uint32_t num;
+  pid_t pid;          // of the daemon (table is ignored when it is gone)
+  srctable_entry_t entries[SRCTABLE_MAX];
+};
+
+using source_list_t = std::vector<std::pair<std::string, std::string>>;  // (name, url)
+
+class SourceTableWriter {
+public:
+  SourceTableWriter();  // creates (or takes over) the segment
+  ~SourceTableWriter(); // removes it
+
+  SourceTableWriter(const SourceTableWriter &) = delete;
+  SourceTableWriter &operator=(const SourceTableWriter &) = delete;
+
+  void publish(const source_list_t &sources);  // (entries beyond SRCTABLE_MAX or too long are skipped)
+
+private:
+  srctable_t *table;
+};
+
+class SourceTableReader {
+public:
+  // false: no (running) daemon
+  bool open();
+  ~SourceTableReader();
+
+  // consistent copy; false: no daemon (anymore)
+  bool snapshot(source_list_t &ret);
+  // true: changed since last snapshot(), incl. the one in lookup() (cheap, to be polled; does not reset)
+  bool changed();
+
+  std::string lookup(const std::string &name);  // empty: unknown
+
+private:
+  const srctable_t *table = nullptr;
+  uint32_t last_seq = 0;
+};
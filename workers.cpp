@@ -0,0 +1,184 @@
+#include "workers.h"
+#include <pthread.h>
+#include <sched.h>
+#include <chrono>
+
+static thread_local int worker_index = 0;
+static thread_local bool in_task = false;
+
+// n-th cpu of the allowed set (wraps around)
+static void pin_thread(std::thread &t, int n)
+{
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+    return;
+  }
+  n %= CPU_COUNT(&allowed);
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed) && n-- == 0) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);  // (best effort)
+      return;
+    }
+  }
+}
+
+WorkerPool::WorkerPool(unsigned num_threads, bool pin)
+{
+  num_threads = std::min(num_threads, max_threads);
+  queues.reset(new queue_t[num_threads + 1]);
+  threads.reserve(num_threads);
+  for (unsigned i = 0; i < num_threads; i++) {
+    threads.emplace_back(&WorkerPool::worker, this, i + 1);
+    if (pin) {
+      pin_thread(threads.back(), i + 1);  // (caller, usually on cpu 0, is left alone)
+    }
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stop = true;
+  }
+  cv.notify_all();
+  for (std::thread &t : threads) {
+    t.join();
+  }
+}
+
+int WorkerPool::current()
+{
+  return worker_index;
+}
+
+WorkerPool::stats_t WorkerPool::stats() const
+{
+  stats_t ret{};
+  ret.runs = runs.load(std::memory_order_relaxed);
+  for (unsigned i = 0; i < size(); i++) {
+    const queue_t &q = queues[i];
+    ret.tasks += q.tasks.load(std::memory_order_relaxed);
+    ret.steals += q.steals.load(std::memory_order_relaxed);
+    ret.task_ns += q.task_ns.load(std::memory_order_relaxed);
+    ret.task_ns_max = std::max(ret.task_ns_max, q.task_ns_max.load(std::memory_order_relaxed));
+  }
+  return ret;
+}
+
+void WorkerPool::dispatch(int num_tasks, call_t call, const void *ctx)
+{
+  if (num_tasks <= 1 || threads.empty() || in_task) {
+    for (int i = 0; i < num_tasks; i++) {
+      call(ctx, i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    this->call = call;
+    this->ctx = ctx;
+    const int n = size();
+    for (int i = 0; i < n; i++) { // (contiguous share each; nobody is in work() between runs)
+      queues[i].begin = (int64_t)i * num_tasks / n;
+      queues[i].end = (int64_t)(i + 1) * num_tasks / n;
+    }
+    pending = threads.size();
+    generation++;
+  }
+  cv.notify_all();
+  runs.fetch_add(1, std::memory_order_relaxed);
+
+  work(0);
+
+  std::unique_lock<std::mutex> lock(mtx);
+  cv_done.wait(lock, [this]() { return pending == 0; });
+  this->call = nullptr;
+}
+
+bool WorkerPool::pop(int self, int &task)
+{
+  queue_t &q = queues[self];
+  std::lock_guard<std::mutex> lock(q.mtx);
+  if (q.begin < q.end) {
+    task = q.begin++;
+    return true;
+  }
+  return false;
+}
+
+// back half of the first non-empty victim: one to run now, the rest into the own (empty) queue
+bool WorkerPool::steal(int self, int &task)
+{
+  const int n = size();
+  for (int i = 1; i < n; i++) {
+    queue_t &victim = queues[(self + i) % n];
+    std::unique_lock<std::mutex> lock(victim.mtx);
+    const int avail = victim.end - victim.begin;
+    if (avail <= 0) {
+      continue;
+    }
+    const int take = (avail + 1) / 2,
+              first = victim.end - take;
+    victim.end = first;
+    lock.unlock();
+
+    task = first;
+    if (take > 1) {
+      queue_t &q = queues[self];
+      std::lock_guard<std::mutex> own(q.mtx);
+      q.begin = first + 1;
+      q.end = first + take;
+    }
+    queue_t &q = queues[self];
+    q.steals.store(q.steals.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+void WorkerPool::work(int self)
+{
+  using clock = std::chrono::steady_clock;
+  queue_t &q = queues[self];
+  in_task = true;
+  int task;
+  while (pop(self, task) || steal(self, task)) {
+    const clock::time_point t0 = clock::now();
+    call(ctx, task);
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t0).count();
+
+    q.tasks.store(q.tasks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    q.task_ns.store(q.task_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    if (ns > q.task_ns_max.load(std::memory_order_relaxed)) {
+      q.task_ns_max.store(ns, std::memory_order_relaxed);
+    }
+  }
+  in_task = false;
+}
+
+void WorkerPool::worker(int self)
+{
+  worker_index = self;
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(mtx);
+  while (true) {
+    cv.wait(lock, [&]() { return stop || generation != seen; });
+    if (stop) {
+      break;
+    }
+    seen = generation;
+    lock.unlock();
+
+    work(self);
+
+    lock.lock();
+    if (--pending == 0) {
+      cv_done.notify_one();
+    }
+  }
+}
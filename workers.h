@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Process-wide set of threads for data-parallel work on the main thread's frames (render strips, scopes, LUT, ...).
+// Fork/join: run() spreads the task indices over per-worker deques, each worker pops its own from the front and, when empty,
+// steals the back half of another's; the caller works along (as worker 0) and returns when all tasks are done.
+// No allocations per dispatch (fn is passed by reference, not as std::function).
+class WorkerPool {
+public:
+  // pin: each worker thread to one cpu of the allowed set (the caller is not pinned)
+  explicit WorkerPool(unsigned num_threads = std::max(std::thread::hardware_concurrency(), 1u) - 1, bool pin = false);  // (+ caller)
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  unsigned size() const { return threads.size() + 1; }  // incl. caller
+
+  static constexpr unsigned max_threads = 255;  // (more are clamped)
+
+  // NOTE: only one run() at a time from outside; nested calls (from within a task) run inline
+  template <typename Fn>
+  void run(int num_tasks, Fn &&fn) {
+    using F = typename std::remove_reference<Fn>::type;
+    dispatch(num_tasks, [](const void *ctx, int task) { (*(F *)ctx)(task); }, &fn);
+  }
+
+  // fn(y0, y1) for [0, rows) in chunks of grain rows (the last one may be shorter)
+  template <typename Fn>
+  void parallel_for(int rows, int grain, Fn &&fn) {
+    grain = std::max(grain, 1);
+    run((rows + grain - 1) / grain, [&](int task) {
+      const int y0 = task * grain;
+      fn(y0, std::min(y0 + grain, rows));
+    });
+  }
+
+  // index of the calling thread, 0 .. size() - 1 (0: caller of run()), e.g. for per-thread buffers
+  static int current();
+
+  struct stats_t {
+    uint64_t runs, tasks, steals;
+    uint64_t task_ns, task_ns_max;  // (latency of single tasks: sum, max)
+  };
+  stats_t stats() const;  // (since start)
+
+private:
+  using call_t = void (*)(const void *ctx, int task);
+  void dispatch(int num_tasks, call_t call, const void *ctx);
+
+  void worker(int self);
+  void work(int self);
+  bool pop(int self, int &task);
+  bool steal(int self, int &task);
+
+  std::vector<std::thread> threads;
+
+  std::mutex mtx;
+  std::condition_variable cv, cv_done;
+  bool stop = false;
+  uint64_t generation = 0;   // (new run)
+  int pending = 0;           // workers still inside work()
+
+  call_t call = nullptr;
+  const void *ctx = nullptr;
+
+  struct alignas(64) queue_t {
+    std::mutex mtx;
+    int begin = 0, end = 0;  // task indices not yet taken: owner pops at begin, thieves take from end
+
+    // (only written by the owning thread)
+    std::atomic<uint64_t> tasks{0}, steals{0}, task_ns{0}, task_ns_max{0};
+  };
+  std::unique_ptr<queue_t[]> queues;  // per worker, [0]: caller
+  std::atomic<uint64_t> runs{0};
+};
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <new>
 
 // NOTE: During an active emit connections MUST NOT be removed, nor .clear() be called!
 
@@ -25,33 +27,50 @@ struct SignalConnectionBase {
 template <typename Sig>
 struct SignalListBase;
 
+// nodes are not necessarily heap allocated (see signal_pool_storage)
+struct signal_node_delete {
+  template <typename Node>
+  void operator()(Node *node) const {
+    node->destroy();
+  }
+};
+
 template <typename Ret, typename... Args>
 struct SignalListBase<Ret(Args...)> : SignalConnectionBase {
+  using node_ptr = std::unique_ptr<SignalListBase, signal_node_delete>;
+
   SignalListBase() = default;
   SignalListBase(bool once) : once(once) { }
   SignalListBase(SignalListBase &&) = delete;  // TODO?
 
   virtual Ret operator()(Args...) = 0;
 
-  virtual void setNext(std::unique_ptr<SignalListBase> &node) {
-    next.swap(node);
+  virtual void destroy() {
+    delete this;
   }
 
+  virtual void notify_empty() { }
+
   void remove_node(SignalConnectionBase *root) override {
     // assert(prev);
+    SignalListBase *r = static_cast<SignalListBase *>(root);
     if (next) {
       next->prev = prev;
     } else {
-      static_cast<SignalListBase *>(root)->prev = prev;
+      r->prev = prev;
     }
 
-    std::unique_ptr<SignalListBase> tmp = std::move(next);
-    prev->setNext(tmp);  // tmp now holds *this and keeps it alive until the current scope ends
-    // ~SignalConnectionBase() will now disarm the connections
+    node_ptr tmp = std::move(next);
+    prev->next.swap(tmp);  // tmp now holds *this
+    tmp.reset();  // ~SignalConnectionBase() disarms the connections
+    // NOTE: *this is gone, but onempty may destroy the Signal (and its storage) only after that
+    if (!r->next) {
+      r->notify_empty();
+    }
   }
 
   SignalListBase *prev = {};
-  std::unique_ptr<SignalListBase> next;
+  node_ptr next;
   bool once = false;  // unused in SignalListRoot, but shall be accessible with only Base*
 };
 
@@ -59,7 +78,7 @@ template <typename Sig, typename Fn>
 struct SignalListNode;
 
 template <typename Ret, typename... Args, typename Fn>
-struct SignalListNode<Ret(Args...), Fn> final : SignalListBase<Ret(Args...)> {
+struct SignalListNode<Ret(Args...), Fn> : SignalListBase<Ret(Args...)> {
   SignalListNode(Fn&& fn, bool once)
     : SignalListBase<Ret(Args...)>(once), fn((Fn&&)fn)
   { }
@@ -72,7 +91,7 @@ struct SignalListNode<Ret(Args...), Fn> final : SignalListBase<Ret(Args...)> {
 };
 
 template <typename... Args, typename Fn>
-struct SignalListNode<void(Args...), Fn> final : SignalListBase<void(Args...)> {
+struct SignalListNode<void(Args...), Fn> : SignalListBase<void(Args...)> {
   SignalListNode(Fn&& fn, bool once)
     : SignalListBase<void(Args...)>(once), fn((Fn&&)fn)
   { }
@@ -84,6 +103,96 @@ struct SignalListNode<void(Args...), Fn> final : SignalListBase<void(Args...)> {
   Fn fn;
 };
 
+template <typename Sig, typename Fn, typename Pool>
+struct SignalPoolNode final : SignalListNode<Sig, Fn> {
+  SignalPoolNode(Pool &pool, Fn&& fn, bool once)
+    : SignalListNode<Sig, Fn>((Fn&&)fn, once), pool(pool)
+  { }
+
+  void destroy() override {
+    Pool &p = pool;
+    this->~SignalPoolNode();
+    p.deallocate(this);
+  }
+
+  Pool &pool;
+};
+
+// Storage policies for Signal: create<Sig>(fn, once) returns a node, which is freed via node->destroy().
+
+struct signal_heap_storage {
+  template <typename Sig, typename Fn>
+  SignalListBase<Sig> *create(Fn&& fn, bool once) {
+    return new SignalListNode<Sig, Fn>{(Fn&&)fn, once};
+  }
+};
+
+// Fixed-size slots, the first InlineSlots of them inside the Signal itself (the common case is one or two handlers),
+// more are added in chunks and kept until the Signal is destroyed. Nodes larger than SlotSize go to the heap.
+template <size_t InlineSlots = 2, size_t SlotSize = 64, size_t ChunkSlots = 8>
+class signal_pool_storage {
+public:
+  signal_pool_storage() {
+    add_slots(inline_slots, InlineSlots);
+  }
+
+  ~signal_pool_storage() {
+    while (chunks) {
+      chunk_t *tmp = chunks;
+      chunks = chunks->next;
+      delete tmp;
+    }
+  }
+
+  signal_pool_storage(const signal_pool_storage &) = delete;
+  signal_pool_storage &operator=(const signal_pool_storage &) = delete;
+
+  template <typename Sig, typename Fn>
+  SignalListBase<Sig> *create(Fn&& fn, bool once) {
+    using node_t = SignalPoolNode<Sig, Fn, signal_pool_storage>;
+    if (sizeof(node_t) > SlotSize || alignof(node_t) > alignof(slot_t)) {
+      return new SignalListNode<Sig, Fn>{(Fn&&)fn, once};
+    }
+    if (!free_list) {
+      chunk_t *chunk = new chunk_t;
+      chunk->next = chunks;
+      chunks = chunk;
+      add_slots(chunk->slots, ChunkSlots);
+    }
+    slot_t *slot = free_list, *next = slot->next;
+    node_t *ret = new (slot->data) node_t{*this, (Fn&&)fn, once};
+    free_list = next;  // (only after construction, which might throw)
+    return ret;
+  }
+
+  void deallocate(void *ptr) {
+    slot_t *slot = static_cast<slot_t *>(ptr);
+    slot->next = free_list;
+    free_list = slot;
+  }
+
+private:
+  union slot_t {
+    slot_t *next;
+    alignas(std::max_align_t) unsigned char data[SlotSize];
+  };
+  struct chunk_t {
+    chunk_t *next;
+    slot_t slots[ChunkSlots];
+  };
+
+  void add_slots(slot_t *slots, size_t num) {
+    for (size_t i = num; i > 0; i--) {  // (first slot ends up first in free_list)
+      slots[i - 1].next = free_list;
+      free_list = &slots[i - 1];
+    }
+  }
+
+  slot_t inline_slots[InlineSlots];
+  slot_t *free_list = nullptr;
+  chunk_t *chunks = nullptr;
+};
+
 template <typename Sig, typename OnEmptyFn = void>
 struct SignalListRoot final : SignalListRoot<Sig, void> {
   using base_t = SignalListBase<Sig>;
@@ -101,12 +210,8 @@ struct SignalListRoot final : SignalListRoot<Sig, void> {
     }
   }
 
-  void setNext(std::unique_ptr<base_t> &node) override {
-    // base_t::setNext(node);
-    base_t::next.swap(node);
-    if (!base_t::next) {
-      onempty();
-    }
+  void notify_empty() override {
+    onempty();
   }
 
 private:
@@ -126,7 +231,9 @@ struct SignalListRoot<Ret(Args...), void> : SignalListBase<Ret(Args...)> {
   void remove_node(SignalConnectionBase *root) override {
     throw 0;
   }
-//  using base_t::setNext;
+  void destroy() override {
+    throw 0;
+  }
 };
 
 enum class reduce_result_t : uint8_t {
@@ -216,7 +323,7 @@ struct Connection final {
   }
 
 private:
-  template <typename Sig, typename OnEmptyFn, typename DefaultRetvalFn>
+  template <typename Sig, typename OnEmptyFn, typename DefaultRetvalFn, typename Storage>
   friend class Signal;
   friend struct detail::SignalConnectionBase;
 
@@ -256,11 +363,11 @@ inline detail::SignalConnectionBase::~SignalConnectionBase()
 }
 
 //template <typename Sig, typename OnEmptyFn = void, typename DefaultRetvalFn = detail::reduce_void>
-template <typename Sig, typename OnEmptyFn = void, typename DefaultRetvalFn = detail::reduce_use_last<void>>
+template <typename Sig, typename OnEmptyFn = void, typename DefaultRetvalFn = detail::reduce_use_last<void>, typename Storage = detail::signal_heap_storage>
 class Signal;
 
-template <typename Ret, typename... Args, typename OnEmptyFn, typename DefaultRetvalFn>
-class Signal<Ret(Args...), OnEmptyFn, DefaultRetvalFn> final {
+template <typename Ret, typename... Args, typename OnEmptyFn, typename DefaultRetvalFn, typename Storage>
+class Signal<Ret(Args...), OnEmptyFn, DefaultRetvalFn, Storage> final {
   using Sig = Ret(Args...);
   using base_t = detail::SignalListBase<Sig>;
 public:
@@ -285,7 +392,7 @@ public:
 
   template <typename Fn>
   Connection prepend(Fn&& fn, bool once = false) {
-    auto node = new detail::SignalListNode<Sig, Fn>{(Fn&&)fn, once};
+    base_t *node = storage.template create<Sig>((Fn&&)fn, once);
     if (root.next) {
       root.next->prev = node;
       node->next = std::move(root.next);
@@ -299,7 +406,7 @@ public:
 
   template <typename Fn>
   Connection append(Fn&& fn, bool once = false) {
-    auto node = new detail::SignalListNode<Sig, Fn>{(Fn&&)fn, once};
+    base_t *node = storage.template create<Sig>((Fn&&)fn, once);
     if (root.prev) {
       // assert(!root.prev->next);
       root.prev->next.reset(node);
@@ -348,6 +455,7 @@ public:
   }
 
 private:
+  Storage storage;  // (must outlive root)
   detail::SignalListRoot<Sig, OnEmptyFn> root;
 };
 
@@ -122,6 +122,32 @@ std::pair<const xcb_visualtype_t *, uint8_t> XcbConnection::visualtype(xcb_scree
   return {NULL, 0};
 }
 
+std::pair<const xcb_visualtype_t *, uint8_t> XcbConnection::find_visualtype(
+  xcb_screen_t *screen, uint8_t depth,
+  uint32_t red_mask, uint32_t green_mask, uint32_t blue_mask)
+{
+  if (!screen) {
+    return {NULL, 0};
+  }
+
+  xcb_depth_iterator_t it = xcb_screen_allowed_depths_iterator(screen);
+  for (; it.rem; xcb_depth_next(&it)) {
+    if (it.data->depth != depth) {
+      continue;
+    }
+    xcb_visualtype_iterator_t jt = xcb_depth_visuals_iterator(it.data);
+    for (; jt.rem; xcb_visualtype_next(&jt)) {
+      if (jt.data->_class == XCB_VISUAL_CLASS_TRUE_COLOR &&
+          jt.data->red_mask == red_mask &&
+          jt.data->green_mask == green_mask &&
+          jt.data->blue_mask == blue_mask) {
+        return {jt.data, it.data->depth};
+      }
+    }
+  }
+  return {NULL, 0};
+}
+
 void XcbConnection::flush()
 {
   const int res = xcb_flush(conn);
@@ -151,9 +177,13 @@ const xcb_format_t *XcbConnection::format(uint8_t depth)
 }
 
 XcbColor XcbConnection::color(uint16_t red, uint16_t green, uint16_t blue)
+{
+  return color(alloc_color(red, green, blue));
+}
+
+XcbColor XcbConnection::color(XcbFuture<xcb_alloc_color_request_t> &&ac)
 {
   xcb_colormap_t cmap = default_colormap(); // TODO?
-  XcbFuture<xcb_alloc_color_request_t> ac{conn, cmap, red, green, blue};
   return {conn, cmap, ac.get()->pixel};
 }
 
@@ -219,9 +249,11 @@ XcbWindow::~XcbWindow()
 
 std::pair<xcb_atom_t, xcb_atom_t> XcbWindow::install_delete_handler()
 {
-  auto wmproto = conn.intern_atom("WM_PROTOCOLS");
-  auto wmdel = conn.intern_atom("WM_DELETE_WINDOW");
+  return install_delete_handler(conn.intern_atom("WM_PROTOCOLS"), conn.intern_atom("WM_DELETE_WINDOW"));
+}
 
+std::pair<xcb_atom_t, xcb_atom_t> XcbWindow::install_delete_handler(XcbAtomFuture &&wmproto, XcbAtomFuture &&wmdel)
+{
   xcb_atom_t wmprotocols_atom = wmproto.get();
   xcb_atom_t wmdelete_atom = wmdel.get();
 
@@ -346,3 +378,28 @@ void XcbGC::change(uint32_t value_mask, std::initializer_list<const uint32_t> va
 #endif
 }
 
+XcbColormap::XcbColormap(XcbConnection &conn, xcb_window_t window, xcb_visualid_t visual)
+  : conn(conn), cmap(XCB_COPY_FROM_PARENT)
+{
+  if (!visual) {
+    return;
+  }
+  cmap = conn.generate_id();
+  xcb_void_cookie_t ck = xcb_create_colormap_checked(
+    conn, XCB_COLORMAP_ALLOC_NONE,
+    cmap, window, visual);
+
+  unique_xcb_generic_error_t error{xcb_request_check(conn, ck)};
+  if (error) {
+    throw XcbGenericError(error->error_code);
+  }
+}
+
+XcbColormap::~XcbColormap()
+{
+  if (cmap != XCB_COPY_FROM_PARENT) {
+    xcb_free_colormap(conn, cmap);
+    conn.flush();
+  }
+}
+
@@ -35,6 +35,8 @@ struct intern_atom_atom {
 };
 } // namespace detail
 
+using XcbAtomFuture = XcbFuture<xcb_intern_atom_request_t, detail::intern_atom_atom>;
+
 using unique_xcb_generic_event_t = std::unique_ptr<xcb_generic_event_t, detail::c_free_deleter>;
 using unique_xcb_generic_error_t = std::unique_ptr<xcb_generic_error_t, detail::c_free_deleter>;
 
@@ -66,9 +68,10 @@ struct XcbConnection final {
     return {conn, !create, len, name};
   }
 
+  // reads from the socket only once, then drains everything already queued
   template <typename Fn>
   bool run_once(Fn&& fn) {
-    while (auto ev = unique_xcb_generic_event_t{xcb_poll_for_event(conn)}) {
+    for (unique_xcb_generic_event_t ev{xcb_poll_for_event(conn)}; ev; ev.reset(xcb_poll_for_queued_event(conn))) {
       if (ev->response_type == 0) {
         auto code = ((xcb_generic_error_t *)ev.get())->error_code;
         throw XcbGenericError(code);
@@ -125,6 +128,13 @@ struct XcbConnection final {
     return default_visualtype(default_screen_num);
   }
 
+  // first TrueColor visual with depth and masks (e.g. 32, ARGB), or (0,0)
+  std::pair<const xcb_visualtype_t *, uint8_t> find_visualtype(xcb_screen_t *screen, uint8_t depth,
+                                                               uint32_t red_mask, uint32_t green_mask, uint32_t blue_mask);
+  std::pair<const xcb_visualtype_t *, uint8_t> find_visualtype(uint8_t depth, uint32_t red_mask, uint32_t green_mask, uint32_t blue_mask) {
+    return find_visualtype(screen(), depth, red_mask, green_mask, blue_mask);
+  }
+
   // (default_gc, default_gc_of_screen(int screen_num) ?)
 
   uint32_t black_pixel(int screen_num) {
@@ -192,6 +202,12 @@ struct XcbConnection final {
   // convenince (TODO? via XcbColormap wrapper?)
   XcbColor color(uint16_t red, uint16_t green, uint16_t blue); // (cmap = default_colormap());
 
+  // split version, to issue the request early and only wait for the reply when needed
+  XcbFuture<xcb_alloc_color_request_t> alloc_color(uint16_t red, uint16_t green, uint16_t blue) {
+    return {conn, default_colormap(), red, green, blue};
+  }
+  XcbColor color(XcbFuture<xcb_alloc_color_request_t> &&ac);
+
 private:
   void cache_screens();
 
@@ -238,6 +254,8 @@ struct XcbWindow final {
   XcbWindow(const XcbWindow &) = delete;
 
   std::pair<xcb_atom_t, xcb_atom_t> install_delete_handler();
+  // with already requested WM_PROTOCOLS, WM_DELETE_WINDOW
+  std::pair<xcb_atom_t, xcb_atom_t> install_delete_handler(XcbAtomFuture &&wmproto, XcbAtomFuture &&wmdel);
 
   void map();
   void unmap();
@@ -273,3 +291,20 @@ private:
   xcb_gcontext_t gc;
 };
 
+struct XcbColormap final {
+  // AllocNone; visual == 0: none, i.e. XCB_COPY_FROM_PARENT
+  XcbColormap(XcbConnection &conn, xcb_window_t window, xcb_visualid_t visual);
+
+  ~XcbColormap();
+
+  XcbColormap(const XcbColormap &) = delete;
+
+  operator xcb_colormap_t () {
+    return cmap;
+  }
+
+private:
+  XcbConnection &conn;
+  xcb_colormap_t cmap;
+};
+
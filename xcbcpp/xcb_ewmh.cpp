@@ -4,14 +4,16 @@
 #define NET_WM_STATE_ADD      1u
 #define NET_WM_STATE_TOGGLE   2u
 
-XcbEWMH::XcbEWMH(XcbConnection &conn)
+XcbEWMH::Atoms::Atoms(XcbConnection &conn)
+  : nwstate(conn.intern_atom("_NET_WM_STATE")),
+    nwsfullscreen(conn.intern_atom("_NET_WM_STATE_FULLSCREEN"))
+{ }
+
+XcbEWMH::XcbEWMH(XcbConnection &conn, Atoms &&atoms)
   : conn(conn)
 {
-  auto nws = conn.intern_atom("_NET_WM_STATE");
-  auto nwsf = conn.intern_atom("_NET_WM_STATE_FULLSCREEN");
-
-  nwstate = nws.get();
-  nwsfullscreen = nwsf.get();
+  nwstate = atoms.nwstate.get();
+  nwsfullscreen = atoms.nwsfullscreen.get();
 }
 
 void XcbEWMH::fullscreen(xcb_window_t win, bool val)
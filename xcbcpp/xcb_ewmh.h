@@ -7,7 +7,15 @@
 // TODO? only request those atoms really needed?
 class XcbEWMH {
 public:
-  XcbEWMH(XcbConnection &conn);
+  // requested atoms, e.g. to be issued together with other requests before any reply is awaited
+  struct Atoms {
+    Atoms(XcbConnection &conn);
+
+    XcbAtomFuture nwstate, nwsfullscreen;
+  };
+
+  XcbEWMH(XcbConnection &conn) : XcbEWMH(conn, Atoms{conn}) {}
+  XcbEWMH(XcbConnection &conn, Atoms &&atoms);
 
   void fullscreen(xcb_window_t win, bool val);   // TODO? root window per screen?
 
@@ -59,6 +59,12 @@ XcbImage::XcbImage(
   }
 }
 
+void XcbImage::prefetch(XcbConnection &conn)
+{
+  xcb_prefetch_extension_data(conn, &xcb_shm_id);
+  xcb_prefetch_maximum_request_length(conn);
+}
+
 void *XcbImage::data()
 {
   void *ret = shm.get();
@@ -76,7 +82,7 @@ void *XcbImage::data(size_t _width, size_t _height)
 {
   width = _width;
   height = _height;
-  row_stride = ((fmt->bits_per_pixel * width) & -fmt->scanline_pad) >> 3;
+  row_stride = ((fmt->bits_per_pixel * width + fmt->scanline_pad - 1) & -fmt->scanline_pad) >> 3;  // (e.g. 16 bpp, odd width)
 
   const size_t size = row_stride * height;
 
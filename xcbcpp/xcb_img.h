@@ -3,10 +3,13 @@
 #include "xcb_base.h"
 #include <xcb/shm.h>
 
-// NOTE: only for XCB_IMAGE_FORMAT_Z_PIXMAP, depth \in { 24, 32 }
+// NOTE: only for XCB_IMAGE_FORMAT_Z_PIXMAP, depth \in { 16, 24, 30, 32 }
 struct XcbImage {
   XcbImage(XcbConnection &conn, xcb_drawable_t drawable, uint8_t depth);
 
+  // optional: issue the MIT-SHM / BIG-REQUESTS queries early, the constructor then does not wait for them
+  static void prefetch(XcbConnection &conn);
+
   XcbImage &operator=(const XcbImage &) = delete;
 
   bool has(size_t _width, size_t _height) const {
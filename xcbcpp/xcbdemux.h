@@ -2,6 +2,8 @@
 
 #include "xcbevents.h"
 #include <typeindex>
+#include <unordered_map>
+#include <vector>
 
 namespace detail {
 
@@ -60,9 +62,10 @@ class signal_for_mem final : public signal_for_mem_base {
     { }
 
     void operator()() {
-      parent.map.erase(key);
-      if (parent.map.empty()) {
-        parent.onempty();
+      signal_for_mem &p = parent;  // (erase destroys *this)
+      p.erase(key);
+      if (p.keys.empty()) {
+        p.onempty();
       }
     }
 
@@ -81,22 +84,33 @@ public:
   }
 
   void operator()(EventType *ev) {
-    auto it = map.find(ev->*Mem);
-    if (it != map.end()) {
-      it->second.emit(ev);
+    const size_t pos = find(ev->*Mem);
+    if (pos != npos) {
+      signals[pos]->emit(ev);
     }
   }
 
   template <typename Fn>
   Connection connect(const T &key, Fn&& fn, SignalFlags flags = {}) {
-    auto res = map.emplace(key, onempty_key{*this, key});
+    size_t pos = find(key);
+    const bool inserted = (pos == npos);
+    if (inserted) {
+      signals.emplace_back(new signal_t{onempty_key{*this, key}});
+      try {
+        keys.push_back(key);
+      } catch (...) {
+        signals.pop_back();
+        throw;
+      }
+      pos = keys.size() - 1;
+    }
     try {
-      return res.first->second.connect((Fn&&)fn, flags);
+      return signals[pos]->connect((Fn&&)fn, flags);
     } catch (...) {
-      if (res.second) { // was inserted
+      if (inserted) {
         // onempty_key{*this, key}(); ...
-        map.erase(key);
-        if (map.empty()) {
+        erase(key);
+        if (keys.empty()) {
           // conn.disconnect();
           onempty();
         }
@@ -106,7 +120,29 @@ public:
   }
 
 private:
-  std::unordered_map<T, Signal<void(EventType *), onempty_key>> map;
+  using signal_t = Signal<void(EventType *), onempty_key, detail::reduce_use_last<void>, detail::signal_pool_storage<>>;
+  static constexpr size_t npos = (size_t)-1;
+
+  // (usually only a handful of keys, e.g. windows: linear scan over contiguous keys beats hashing)
+  size_t find(const T &key) const {
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (keys[i] == key) {
+        return i;
+      }
+    }
+    return npos;
+  }
+
+  void erase(const T &key) {
+    const size_t pos = find(key);
+    if (pos != npos) {
+      keys.erase(keys.begin() + pos);
+      signals.erase(signals.begin() + pos);
+    }
+  }
+
+  std::vector<T> keys;
+  std::vector<std::unique_ptr<signal_t>> signals;  // (same order as keys; Signal itself is not movable)
   Connection conn;
   OnEmptyFn onempty;
 };
@@ -2,7 +2,9 @@
 
 #include "signals.h"
 #include "xcb_base.h" // esp. for xcb_proto.tcc detail::event_handler_type
-#include <unordered_map>
+#include <array>
+#include <stdexcept>
+#include <typeinfo>
 #include "getargtype.h"
 
 struct XcbEventCallbacks {
@@ -24,11 +26,13 @@ struct XcbEventCallbacks {
   }
 
   void emit(uint8_t type, xcb_generic_event_t *ev) const {
-    auto it = map.find(type);
-    if (it == map.end()) {
+    if (type >= num_types) {
       return;
     }
-    it->second->emit(ev);
+    const slot_t &slot = slots[type];
+    if (slot.emit) {
+      slot.emit(slot.signal.get(), ev);
+    }
   }
 
   void emit(xcb_generic_event_t *ev) const {
@@ -36,9 +40,11 @@ struct XcbEventCallbacks {
   }
 
 private:
+  // (response_type without the "sent event" bit)
+  static constexpr unsigned int num_types = 128;
+
   struct TypedEventSignalBase {
     virtual ~TypedEventSignalBase() = default;
-    virtual void emit(xcb_generic_event_t *ev) = 0;
   };
 
   template <typename EventTypePtr>
@@ -47,12 +53,13 @@ private:
       : parent(parent), type(type), signal(*this)
     { }
 
-    void emit(xcb_generic_event_t *ev) override {
-      signal.emit((EventTypePtr)ev);
+    // stored in the dispatch table, instead of a virtual call
+    static void emit(TypedEventSignalBase *self, xcb_generic_event_t *ev) {
+      static_cast<TypedEventSignal *>(self)->signal.emit((EventTypePtr)ev);
     }
 
     void operator()() const { // onempty
-      parent.map.erase(type);
+      parent.slots[type] = {};
     }
 
     template <typename Fn>
@@ -64,36 +71,40 @@ private:
     XcbEventCallbacks &parent;
     uint8_t type;
 
-    Signal<void(EventTypePtr), TypedEventSignal &, detail::reduce_void> signal;
+    Signal<void(EventTypePtr), TypedEventSignal &, detail::reduce_void, detail::signal_pool_storage<>> signal;
   };
 
   template <typename EventTypePtr, typename Fn>
   Connection _connect(uint8_t type, Fn&& fn, SignalFlags flags) {
-    auto &res = map[type];
-    if (!res) { // was inserted
-      try {
-        std::unique_ptr<TypedEventSignal<EventTypePtr>> signal{new TypedEventSignal<EventTypePtr>{*this, type}};
-        Connection ret = signal->connect((Fn&&)fn, flags);
-        res = std::move(signal);
-        return ret;
-      } catch (...) {
-        map.erase(type); // remove empty unique_ptr from map
-        throw;
-      }
+    if (type >= num_types) {
+      throw std::out_of_range("event type");
+    }
+    slot_t &slot = slots[type];
+    if (!slot.signal) {
+      std::unique_ptr<TypedEventSignal<EventTypePtr>> signal{new TypedEventSignal<EventTypePtr>{*this, type}};
+      Connection ret = signal->connect((Fn&&)fn, flags);
+      slot.signal = std::move(signal);
+      slot.emit = &TypedEventSignal<EventTypePtr>::emit;
+      return ret;
     } else {
 #if 1
-      auto &tmp = *res;  // avoid clang warning for  typeid(*res)
+      auto &tmp = *slot.signal;  // avoid clang warning for  typeid(*res)
       if (typeid(TypedEventSignal<EventTypePtr>&) != typeid(tmp)) {
         throw std::bad_cast();
       }
       TypedEventSignal<EventTypePtr> &signal = static_cast<TypedEventSignal<EventTypePtr> &>(tmp);
 #else
-      TypedEventSignal<EventTypePtr> &signal = dynamic_cast<TypedEventSignal<EventTypePtr> &>(*res);
+      TypedEventSignal<EventTypePtr> &signal = dynamic_cast<TypedEventSignal<EventTypePtr> &>(*slot.signal);
 #endif
       return signal.connect((Fn&&)fn, flags);
     }
   }
 
-  std::unordered_map<uint8_t, std::unique_ptr<TypedEventSignalBase>> map;
+  // dispatch table, directly indexed by type
+  struct slot_t {
+    void (*emit)(TypedEventSignalBase *self, xcb_generic_event_t *ev) = nullptr;
+    std::unique_ptr<TypedEventSignalBase> signal;
+  };
+  std::array<slot_t, num_types> slots;
 };
 